@@ -1,63 +1,1101 @@
 #include <iostream>
 #include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <condition_variable>
 
 using namespace std;
 
+// Exact cover by Knuth's Algorithm X with dancing links.
+// Pick the primary column with the fewest rows, try each of its rows,
+// covering every column the row hits, and undo on the way back.
+// Primary columns must be covered exactly once, secondary ones (such
+// as N-Queens diagonals) at most once. Nodes live in flat index arrays,
+// node 0 is the root and nodes 1 .. num of columns the column headers
+struct ExactCover {
+
+	ExactCover(int num_primary, int num_secondary = 0) {
+		int num_cols = num_primary + num_secondary;
+		for (int c = 0; c <= num_cols; ++ c) {
+			this->add_node(c, -1);
+			this->up[c] = this->down[c] = c;
+			if (c == 0 || c > num_primary) {
+				// root and secondary headers stay out of the header list
+				this->left[c] = this->right[c] = c;
+			} else {
+				this->left[c] = c - 1;
+				this->right[c - 1] = c;
+				this->right[c] = 0;
+				this->left[0] = c;
+			}
+		}
+	}
+
+	// add a row hitting cols, numbered from 0 with primary ones first
+	// return the row id
+	int add_row(const vector<int>& cols) {
+		int row = this->num_rows ++;
+		int first = -1;
+		for (int col : cols) {
+			int c = col + 1;
+			int node = this->add_node(c, row);
+			// bottom of the column
+			this->up[node] = this->up[c];
+			this->down[node] = c;
+			this->down[this->up[c]] = node;
+			this->up[c] = node;
+			++ this->sizes[c];
+			// end of the row
+			if (first < 0) {
+				first = node;
+				this->left[node] = this->right[node] = node;
+			} else {
+				this->left[node] = this->left[first];
+				this->right[node] = first;
+				this->right[this->left[first]] = node;
+				this->left[first] = node;
+			}
+		}
+		return row;
+	}
+
+	// call visit with the row ids of every solution until it returns
+	// false, return the num of solutions visited
+	template <typename Visit>
+	uint64_t solve(Visit visit) {
+		this->count = 0;
+		this->num_nodes = 0;
+		this->stop = false;
+		this->chosen.clear();
+		this->search(visit);
+		return this->count;
+	}
+
+	uint64_t count_solutions() {
+		return this->solve([](const vector<int>&) { return true; });
+	}
+
+	// num of search nodes in the last solve
+	uint64_t get_num_nodes() const {
+		return this->num_nodes;
+	}
+
+private:
+	// links and owners of each node
+	vector<int> left;
+	vector<int> right;
+	vector<int> up;
+	vector<int> down;
+	vector<int> column;
+	vector<int> row;
+	// rows left in each column, by header
+	vector<int> sizes;
+	int num_rows = 0;
+
+	// search state
+	vector<int> chosen;
+	vector<int> solution;
+	uint64_t count;
+	uint64_t num_nodes;
+	bool stop;
+
+	int add_node(int col, int row) {
+		this->left.push_back(0);
+		this->right.push_back(0);
+		this->up.push_back(0);
+		this->down.push_back(0);
+		this->column.push_back(col);
+		this->row.push_back(row);
+		if (row < 0) {
+			this->sizes.push_back(0);
+		}
+		return int(this->column.size()) - 1;
+	}
+
+	// take column c out of the header list and its rows out of other columns
+	void cover(int c) {
+		this->right[this->left[c]] = this->right[c];
+		this->left[this->right[c]] = this->left[c];
+		for (int i = this->down[c]; i != c; i = this->down[i]) {
+			for (int j = this->right[i]; j != i; j = this->right[j]) {
+				this->down[this->up[j]] = this->down[j];
+				this->up[this->down[j]] = this->up[j];
+				-- this->sizes[this->column[j]];
+			}
+		}
+	}
+
+	// exact reverse of cover
+	void uncover(int c) {
+		for (int i = this->up[c]; i != c; i = this->up[i]) {
+			for (int j = this->left[i]; j != i; j = this->left[j]) {
+				++ this->sizes[this->column[j]];
+				this->down[this->up[j]] = j;
+				this->up[this->down[j]] = j;
+			}
+		}
+		this->right[this->left[c]] = c;
+		this->left[this->right[c]] = c;
+	}
+
+	template <typename Visit>
+	void search(Visit& visit) {
+		++ this->num_nodes;
+		if (this->right[0] == 0) {
+			++ this->count;
+			this->solution.clear();
+			for (int node : this->chosen) {
+				this->solution.push_back(this->row[node]);
+			}
+			this->stop = !visit(this->solution);
+			return;
+		}
+
+		// fewest rows first, a dead end shows up right away
+		int c = this->right[0];
+		for (int j = this->right[c]; j != 0; j = this->right[j]) {
+			if (this->sizes[j] < this->sizes[c]) {
+				c = j;
+			}
+		}
+		if (this->sizes[c] == 0) {
+			return;
+		}
+
+		this->cover(c);
+		for (int i = this->down[c]; i != c && !this->stop; i = this->down[i]) {
+			this->chosen.push_back(i);
+			for (int j = this->right[i]; j != i; j = this->right[j]) {
+				this->cover(this->column[j]);
+			}
+			this->search(visit);
+			for (int j = this->left[i]; j != i; j = this->left[j]) {
+				this->uncover(this->column[j]);
+			}
+			this->chosen.pop_back();
+		}
+		this->uncover(c);
+	}
+
+};
+
+// Sudoku as exact cover, a row per (cell, digit) and a column per
+// cell, (row, digit), (col, digit) and (box, digit) to fill once
+struct SudokuSolver {
+
+	// grid holds 81 digits row by row, 0 for blanks,
+	// filled in on success
+	bool solve(vector<int>& grid) {
+		ExactCover cover(4 * 81);
+		vector<int> cells;
+		for (int cell = 0; cell < 81; ++ cell) {
+			int r = cell / 9;
+			int c = cell % 9;
+			int box = r / 3 * 3 + c / 3;
+			for (int digit = 1; digit <= 9; ++ digit) {
+				// a given leaves a single candidate
+				if (grid[cell] && grid[cell] != digit) {
+					continue;
+				}
+				int d = digit - 1;
+				cover.add_row({ cell, 81 + r * 9 + d, 162 + c * 9 + d, 243 + box * 9 + d });
+				cells.push_back(cell * 10 + digit);
+			}
+		}
+
+		vector<int> rows;
+		if (!cover.solve([&rows](const vector<int>& solution) { rows = solution; return false; })) {
+			return false;
+		}
+		for (int row : rows) {
+			grid[cells[row] / 10] = cells[row] % 10;
+		}
+		return true;
+	}
+
+};
+
+// Bitboard N-Queens, one bit per column.
+// cols, ld and rd mark the columns attacked in the current row by
+// queens above, diagonals shift one column per row
 struct NQueensSolver {
-	
+
+	enum Mode {
+		FIRST,		// stop at the first solution
+		COUNT,		// count every solution
+		ENUMERATE	// count and keep every solution
+	};
+
 	NQueensSolver(int n) {
+		// one bit per column in a 64 bit board
+		assert(n >= 1 && n <= 63);
 		this->n = n;
-		// resize stuff
-		this->rows.resize(n);
-		this->cols.resize(n, true);
-		this->left_diags.resize(n * 2 - 1, true);
-		this->right_diags.resize(n * 2 - 1, true);
+		this->full = (uint64_t(1) << n) - 1;
 	}
-	
-	void solve() {
-		this->put_queen(0);
+
+	// return the num of solutions found
+	uint64_t solve(Mode mode = COUNT) {
+		this->mode = mode;
+		this->cancel = false;
+		Search search(this->n);
+
+		if (mode == FIRST) {
+			search.weight = 1;
+			this->put_queen(search, 0, this->full, 0, 0, 0);
+		} else {
+			// every solution with the first queen in the left half
+			// mirrors to one in the right half
+			search.weight = 2;
+			this->put_queen(search, 0, this->full >> (this->n - this->n / 2), 0, 0, 0);
+			// the middle column of an odd board mirrors onto itself
+			if (this->n % 2) {
+				search.weight = 1;
+				this->put_queen(search, 0, uint64_t(1) << (this->n / 2), 0, 0, 0);
+			}
+		}
+		this->first = search.first;
+		this->solutions.swap(search.solutions);
+		return search.count;
+	}
+
+	// same as solve, with the top rows expanded into subproblems that
+	// num_threads workers (0 for one per core) take from their own
+	// queues, stealing from each other once they run dry
+	uint64_t solve_parallel(Mode mode = COUNT, int num_threads = 0) {
+		if (num_threads <= 0) {
+			num_threads = max(1, int(thread::hardware_concurrency()));
+		}
+		this->mode = mode;
+		this->cancel = false;
+		vector<Task> tasks = this->expand(mode, num_threads * TASKS_PER_THREAD);
+
+		// deal the subproblems round robin
+		vector<deque<Task>> queues(num_threads);
+		vector<mutex> locks(num_threads);
+		for (size_t i = 0; i < tasks.size(); ++ i) {
+			queues[i % num_threads].push_back(tasks[i]);
+		}
+
+		vector<Search> searches(num_threads, Search(this->n));
+		vector<thread> workers;
+		for (int id = 0; id < num_threads; ++ id) {
+			workers.emplace_back([this, id, &queues, &locks, &searches]() {
+				Search& search = searches[id];
+				Task task;
+				// own queue from the back, victims from the front; nothing
+				// new gets queued, so all queues empty means done
+				while (!this->cancel && (take(queues[id], locks[id], task, true) ||
+										 this->steal(queues, locks, id, task))) {
+					copy(task.prefix.begin(), task.prefix.end(), search.rows.begin());
+					search.weight = task.weight;
+					this->put_queen(search, task.row, this->full, task.cols, task.ld, task.rd);
+				}
+			});
+		}
+		for (thread& worker : workers) {
+			worker.join();
+		}
+
+		// reduce the per thread results
+		uint64_t count = 0;
+		this->solutions.clear();
+		for (Search& search : searches) {
+			count += search.count;
+			this->solutions.insert(this->solutions.end(), search.solutions.begin(), search.solutions.end());
+			if (mode == FIRST && search.count) {
+				this->first = search.first;
+			}
+		}
+		// only one worker reports under FIRST
+		return mode == FIRST ? min(count, uint64_t(1)) : count;
+	}
+
+	// same as solve through ExactCover, a row per square, a primary
+	// column per board row and column and a secondary one per diagonal
+	uint64_t solve_exact_cover(Mode mode = COUNT) {
+		int n = this->n;
+		ExactCover cover(2 * n, 2 * (2 * n - 1));
+		for (int r = 0; r < n; ++ r) {
+			for (int c = 0; c < n; ++ c) {
+				cover.add_row({ r, n + c, 2 * n + r + c, 2 * n + (2 * n - 1) + r - c + n - 1 });
+			}
+		}
+
+		this->first.clear();
+		this->solutions.clear();
+		vector<int> rows(n);
+		return cover.solve([this, mode, n, &rows](const vector<int>& solution) {
+			for (int square : solution) {
+				rows[square / n] = square % n;
+			}
+			if (this->first.empty()) {
+				this->first = rows;
+			}
+			if (mode == ENUMERATE) {
+				this->solutions.insert(this->solutions.end(), rows.begin(), rows.end());
+			}
+			return mode != FIRST;
+		});
+	}
+
+	// column of the queen in each row of the first solution
+	const vector<int>& get_solution() const {
+		return this->first;
+	}
+
+	// ENUMERATE keeps every solution here, n columns after another
+	const vector<int>& get_solutions() const {
+		return this->solutions;
 	}
 
 private:
+	// state of one search, each worker has its own
+	struct Search {
+		explicit Search(int n) : rows(n) {}
+
+		// col of the queen in each row
+		vector<int> rows;
+		uint64_t count = 0;
+		// solutions each found one stands for
+		uint64_t weight = 1;
+		vector<int> first;
+		vector<int> solutions;
+	};
+
+	// a board with the first rows filled in
+	struct Task {
+		int row;
+		uint64_t cols;
+		uint64_t ld;
+		uint64_t rd;
+		uint64_t weight;
+		vector<int> prefix;
+	};
+
+	// enough subproblems for stealing to even out the load
+	static const int TASKS_PER_THREAD = 16;
+
 	int n;
-	
-	// cols and rows indicator
-	vector<int> rows;
-	// diagonals indicator
-	vector<bool> cols;
-	vector<bool> left_diags;
-	vector<bool> right_diags;
-	
-	void put_queen(int row) {
-		// check each column
-		for (int col = 0; col < this->n; ++ col) {
-			if (this->cols[col] && this->left_diags[row + col] && this->right_diags[row - col + this->n - 1]) {
-				this->rows[row] = col;
-				this->cols[col] = false;
-				this->left_diags[row + col] = false;
-				this->right_diags[row - col + this->n - 1] = false;
-				
-				// check end
-				if (row == this->n - 1) {
-					cout << "Found One solution" << endl;
-					return;
+	uint64_t full;
+	Mode mode;
+	// tells every worker to stop, set on the first solution under FIRST
+	atomic<bool> cancel;
+
+	vector<int> first;
+	vector<int> solutions;
+
+	static int lowest_bit(uint64_t bit) {
+#ifdef __GNUC__
+		return __builtin_ctzll(bit);
+#else
+		int index = 0;
+		while (!(bit & 1)) {
+			bit >>= 1;
+			++ index;
+		}
+		return index;
+#endif
+	}
+
+	// allowed limits the columns tried in this row
+	void put_queen(Search& search, int row, uint64_t allowed, uint64_t cols, uint64_t ld, uint64_t rd) {
+		if (row == this->n) {
+			this->record(search);
+			return;
+		}
+		uint64_t avail = allowed & ~(cols | ld | rd);
+		while (avail) {
+			// take the lowest free column
+			uint64_t bit = avail & (~avail + 1);
+			avail ^= bit;
+			search.rows[row] = lowest_bit(bit);
+
+			this->put_queen(search, row + 1, this->full, cols | bit,
+							((ld | bit) << 1) & this->full, (rd | bit) >> 1);
+			if (this->mode == FIRST && (search.count || this->cancel)) {
+				return;
+			}
+		}
+	}
+
+	void record(Search& search) {
+		if (this->mode == FIRST) {
+			// another worker may have won already
+			if (this->cancel.exchange(true)) {
+				return;
+			}
+			search.first = search.rows;
+		}
+		search.count += search.weight;
+		if (this->mode != ENUMERATE) {
+			return;
+		}
+		search.solutions.insert(search.solutions.end(), search.rows.begin(), search.rows.end());
+		if (search.weight == 2) {
+			for (int col : search.rows) {
+				search.solutions.push_back(this->n - 1 - col);
+			}
+		}
+	}
+
+	// expand boards row by row, with the same mirror split
+	// as solve, until there are at least min_tasks of them
+	vector<Task> expand(Mode mode, size_t min_tasks) const {
+		vector<Task> tasks;
+		Task root = { 0, 0, 0, 0, 1, vector<int>() };
+		if (mode == FIRST) {
+			this->expand_row(root, this->full, tasks);
+		} else {
+			root.weight = 2;
+			this->expand_row(root, this->full >> (this->n - this->n / 2), tasks);
+			if (this->n % 2) {
+				root.weight = 1;
+				this->expand_row(root, uint64_t(1) << (this->n / 2), tasks);
+			}
+		}
+
+		// boards of the same depth, stop before the last row
+		int row = 1;
+		while (tasks.size() < min_tasks && row < this->n - 1) {
+			vector<Task> next;
+			for (const Task& task : tasks) {
+				this->expand_row(task, this->full, next);
+			}
+			tasks.swap(next);
+			++ row;
+		}
+		return tasks;
+	}
+
+	// one task per free column of the task's next row
+	void expand_row(const Task& task, uint64_t allowed, vector<Task>& out) const {
+		uint64_t avail = allowed & ~(task.cols | task.ld | task.rd);
+		while (avail) {
+			uint64_t bit = avail & (~avail + 1);
+			avail ^= bit;
+			Task child = { task.row + 1, task.cols | bit, ((task.ld | bit) << 1) & this->full,
+						   (task.rd | bit) >> 1, task.weight, task.prefix };
+			child.prefix.push_back(lowest_bit(bit));
+			out.push_back(child);
+		}
+	}
+
+	// pop a task off one end of a queue
+	static bool take(deque<Task>& queue, mutex& lock, Task& task, bool back) {
+		lock_guard<mutex> guard(lock);
+		if (queue.empty()) {
+			return false;
+		}
+		if (back) {
+			task = queue.back();
+			queue.pop_back();
+		} else {
+			task = queue.front();
+			queue.pop_front();
+		}
+		return true;
+	}
+
+	// try every other queue once
+	static bool steal(vector<deque<Task>>& queues, vector<mutex>& locks, int id, Task& task) {
+		int num_queues = int(queues.size());
+		for (int i = 1; i < num_queues; ++ i) {
+			int victim = (id + i) % num_queues;
+			if (take(queues[victim], locks[victim], task, false)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+};
+
+
+// Generic branch and bound, maximizing.
+// Problem supplies the callbacks
+//	Node, Value				subproblem and objective types
+//	bound(node)				upper bound of anything below node
+//	feasible(node)			whether node is a solution by itself
+//	value(node)				its objective when feasible
+//	branch(node, children)	append the subproblems of node
+// Workers share the open nodes and the incumbent, a node whose bound
+// cannot beat the incumbent is dropped without branching
+template <typename Problem>
+struct BranchAndBound {
+
+	typedef typename Problem::Node Node;
+	typedef typename Problem::Value Value;
+
+	enum Strategy {
+		DEPTH_FIRST,	// newest open node first, little memory
+		BEST_FIRST,		// highest bound first, fewest nodes
+		HYBRID			// best first, then dive into the best child
+	};
+
+	// past max_open open nodes, children are explored depth first
+	// by the worker that made them instead of being queued
+	BranchAndBound(const Problem& problem, Strategy strategy = HYBRID, size_t max_open = 1 << 20)
+	: problem(problem), strategy(strategy), max_open(max_open) {}
+
+	// search below root, return whether any feasible node was found
+	bool solve(const Node& root, int num_threads = 1) {
+		this->found = false;
+		this->incumbent = Value();
+		this->open.clear();
+		this->active = 0;
+		this->waiting = 0;
+		this->num_nodes = 0;
+		this->open.push_back(Open_Node(this->problem.bound(root), root));
+
+		vector<thread> workers;
+		for (int i = 1; i < num_threads; ++ i) {
+			workers.emplace_back([this]() { this->work(); });
+		}
+		this->work();
+		for (thread& worker : workers) {
+			worker.join();
+		}
+		return this->found;
+	}
+
+	// best feasible node and its value
+	const Node& get_best() const {
+		return this->best;
+	}
+
+	Value get_value() const {
+		return this->incumbent;
+	}
+
+	// num of nodes branched on
+	size_t get_num_nodes() const {
+		return this->num_nodes;
+	}
+
+private:
+	struct Open_Node {
+		Open_Node() {}
+		Open_Node(Value bound, const Node& node) : bound(bound), node(node) {}
+
+		Value bound;
+		Node node;
+
+		bool operator<(const Open_Node& rhs) const {
+			return this->bound < rhs.bound;
+		}
+	};
+
+	const Problem& problem;
+	Strategy strategy;
+	size_t max_open;
+
+	// incumbent, read without the lock for pruning
+	atomic<bool> found;
+	atomic<Value> incumbent;
+	Node best;
+	mutex best_lock;
+
+	// open nodes, a stack for DEPTH_FIRST and a max heap on bound otherwise
+	vector<Open_Node> open;
+	mutex open_lock;
+	condition_variable open_ready;
+	// workers holding nodes, and workers waiting for some
+	int active;
+	atomic<int> waiting;
+	atomic<size_t> num_nodes;
+
+	bool prunable(Value bound) const {
+		return this->found && !(this->incumbent < bound);
+	}
+
+	void offer(const Node& node) {
+		Value value = this->problem.value(node);
+		if (this->found && !(this->incumbent < value)) {
+			return;
+		}
+		lock_guard<mutex> guard(this->best_lock);
+		if (!this->found || this->incumbent < value) {
+			this->best = node;
+			this->incumbent = value;
+			this->found = true;
+		}
+	}
+
+	// take an open node, false once every node is done
+	bool pop(Open_Node& top) {
+		unique_lock<mutex> guard(this->open_lock);
+		++ this->waiting;
+		this->open_ready.wait(guard, [this]() { return !this->open.empty() || this->active == 0; });
+		-- this->waiting;
+		if (this->open.empty()) {
+			this->open_ready.notify_all();
+			return false;
+		}
+		if (this->strategy == DEPTH_FIRST) {
+			top = this->open.back();
+			this->open.pop_back();
+		} else {
+			pop_heap(this->open.begin(), this->open.end());
+			top = this->open.back();
+			this->open.pop_back();
+			// the best bound is pruned, so is everything else
+			if (this->prunable(top.bound)) {
+				this->open.clear();
+			}
+		}
+		++ this->active;
+		return true;
+	}
+
+	void push(const Open_Node& node) {
+		lock_guard<mutex> guard(this->open_lock);
+		this->open.push_back(node);
+		if (this->strategy != DEPTH_FIRST) {
+			push_heap(this->open.begin(), this->open.end());
+		}
+		this->open_ready.notify_one();
+	}
+
+	void finish() {
+		lock_guard<mutex> guard(this->open_lock);
+		if (-- this->active == 0 && this->open.empty()) {
+			this->open_ready.notify_all();
+		}
+	}
+
+	size_t num_open() {
+		lock_guard<mutex> guard(this->open_lock);
+		return this->open.size();
+	}
+
+	void work() {
+		// nodes this worker dives into
+		vector<Open_Node> local;
+		vector<Node> children;
+		vector<Open_Node> kept;
+		Open_Node top;
+		while (this->pop(top)) {
+			local.push_back(top);
+			while (!local.empty()) {
+				Open_Node current = local.back();
+				local.pop_back();
+				if (this->prunable(current.bound)) {
+					continue;
+				}
+				if (this->problem.feasible(current.node)) {
+					this->offer(current.node);
+				}
+				++ this->num_nodes;
+
+				children.clear();
+				this->problem.branch(current.node, children);
+				kept.clear();
+				for (const Node& child : children) {
+					Value bound = this->problem.bound(child);
+					if (!this->prunable(bound)) {
+						kept.push_back(Open_Node(bound, child));
+					}
+				}
+				this->schedule(kept, local);
+			}
+			this->finish();
+		}
+	}
+
+	// queue children for everyone or keep them for this worker's dive
+	void schedule(vector<Open_Node>& children, vector<Open_Node>& local) {
+		if (children.empty()) {
+			return;
+		}
+		bool full = this->num_open() >= this->max_open;
+		if (this->strategy == DEPTH_FIRST || full) {
+			// first child on top of the stack, hand the rest to idle workers
+			bool share = !full && this->waiting > 0;
+			for (size_t i = children.size(); i -- > 0;) {
+				if (share && i > 0) {
+					this->push(children[i]);
 				} else {
-					this->put_queen(row + 1);
+					local.push_back(children[i]);
 				}
-				// backtrack
-				this->cols[col] = true;
-				this->left_diags[row + col] = true;
-				this->right_diags[row - col + this->n -1] = true;
+			}
+			return;
+		}
+
+		size_t keep = children.size();
+		if (this->strategy == HYBRID) {
+			// dive into the most promising child
+			keep = max_element(children.begin(), children.end()) - children.begin();
+			local.push_back(children[keep]);
+		}
+		for (size_t i = 0; i < children.size(); ++ i) {
+			if (i != keep) {
+				this->push(children[i]);
 			}
 		}
 	}
-	
+
 };
 
+// 0/1 knapsack for branch and bound, values and weights in 64 bits.
+// Items are taken in order of value per weight, the bound is the
+// fractional relaxation over the items not decided yet, found by
+// binary search on prefix sums
+struct KnapsackProblem {
+
+	typedef int64_t Value;
+
+	// items taken so far, shared between a node and its children
+	struct Taken {
+		int item;
+		shared_ptr<const Taken> next;
+	};
+
+	struct Node {
+		// items before level are decided
+		int level;
+		int64_t weight;
+		int64_t value;
+		shared_ptr<const Taken> taken;
+	};
+
+	KnapsackProblem(const vector<int64_t>& weights, const vector<int64_t>& values, int64_t capacity)
+	: capacity(capacity) {
+		// best value per weight first
+		for (size_t i = 0; i < weights.size(); ++ i) {
+			this->order.push_back(int(i));
+		}
+		sort(this->order.begin(), this->order.end(), [&weights, &values](int a, int b) {
+			return (long double)values[a] * weights[b] > (long double)values[b] * weights[a];
+		});
+
+		this->weight_sums.push_back(0);
+		this->value_sums.push_back(0);
+		for (int i : this->order) {
+			this->weights.push_back(weights[i]);
+			this->values.push_back(values[i]);
+			this->weight_sums.push_back(this->weight_sums.back() + weights[i]);
+			this->value_sums.push_back(this->value_sums.back() + values[i]);
+		}
+	}
+
+	Node root() const {
+		Node node = { 0, 0, 0, nullptr };
+		return node;
+	}
+
+	Value bound(const Node& node) const {
+		int n = int(this->weights.size());
+		int64_t room = this->capacity - node.weight;
+		// items level .. end - 1 fit whole
+		int end = int(upper_bound(this->weight_sums.begin() + node.level, this->weight_sums.end(),
+								  this->weight_sums[node.level] + room) - this->weight_sums.begin()) - 1;
+		Value result = node.value + this->value_sums[end] - this->value_sums[node.level];
+		if (end < n) {
+			// and a fraction of the next one
+			room -= this->weight_sums[end] - this->weight_sums[node.level];
+			result += Value((long double)room * this->values[end] / this->weights[end]);
+		}
+		return result;
+	}
+
+	// every node leaves the rest out and is a packing by itself
+	bool feasible(const Node&) const {
+		return true;
+	}
+
+	Value value(const Node& node) const {
+		return node.value;
+	}
+
+	// take the next item if it fits, then leave it
+	void branch(const Node& node, vector<Node>& children) const {
+		if (node.level == int(this->weights.size())) {
+			return;
+		}
+		int item = node.level;
+		if (node.weight + this->weights[item] <= this->capacity) {
+			shared_ptr<const Taken> taken(new Taken{ this->order[item], node.taken });
+			Node with = { item + 1, node.weight + this->weights[item], node.value + this->values[item], taken };
+			children.push_back(with);
+		}
+		Node without = { item + 1, node.weight, node.value, node.taken };
+		children.push_back(without);
+	}
+
+	// original indices of the items in node, ascending
+	vector<int> items(const Node& node) const {
+		vector<int> result;
+		for (const Taken* taken = node.taken.get(); taken; taken = taken->next.get()) {
+			result.push_back(taken->item);
+		}
+		sort(result.begin(), result.end());
+		return result;
+	}
+
+private:
+	int64_t capacity;
+	// by value per weight
+	vector<int> order;
+	vector<int64_t> weights;
+	vector<int64_t> values;
+	// prefix sums over the sorted items
+	vector<int64_t> weight_sums;
+	vector<int64_t> value_sums;
+};
+
+// known num of solutions for n = 1 .. 12
+const uint64_t NQUEENS_COUNTS[] = { 1, 0, 0, 2, 10, 4, 40, 92, 352, 724, 2680, 14200 };
+
+// no two queens share a column or a diagonal
+bool valid_queens(const int* rows, int n) {
+	for (int r = 0; r < n; ++ r) {
+		if (rows[r] < 0 || rows[r] >= n) {
+			return false;
+		}
+		for (int s = 0; s < r; ++ s) {
+			if (rows[s] == rows[r] || abs(rows[s] - rows[r]) == r - s) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// ENUMERATE output holds count distinct valid boards
+bool valid_solutions(const vector<int>& solutions, int n, uint64_t count) {
+	if (solutions.size() != count * n) {
+		return false;
+	}
+	vector<vector<int>> boards;
+	for (size_t i = 0; i < solutions.size(); i += n) {
+		if (!valid_queens(&solutions[i], n)) {
+			return false;
+		}
+		boards.push_back(vector<int>(solutions.begin() + i, solutions.begin() + i + n));
+	}
+	sort(boards.begin(), boards.end());
+	return unique(boards.begin(), boards.end()) == boards.end();
+}
+
+void test_nqueens() {
+	for (int n = 1; n <= 12; ++ n) {
+		uint64_t expected = NQUEENS_COUNTS[n - 1];
+		NQueensSolver solver(n);
+		assert(solver.solve(NQueensSolver::COUNT) == expected);
+
+		assert(solver.solve(NQueensSolver::FIRST) == min(expected, uint64_t(1)));
+		if (expected) {
+			assert(valid_queens(solver.get_solution().data(), n));
+		}
+
+		if (n <= 8) {
+			assert(solver.solve(NQueensSolver::ENUMERATE) == expected);
+			assert(valid_solutions(solver.get_solutions(), n, expected));
+		}
+
+		// one thread, a few and one per core
+		int thread_counts[] = { 1, 4, 0 };
+		for (int num_threads : thread_counts) {
+			assert(solver.solve_parallel(NQueensSolver::COUNT, num_threads) == expected);
+			assert(solver.solve_parallel(NQueensSolver::FIRST, num_threads) == min(expected, uint64_t(1)));
+			if (expected) {
+				assert(valid_queens(solver.get_solution().data(), n));
+			}
+			if (n <= 8) {
+				assert(solver.solve_parallel(NQueensSolver::ENUMERATE, num_threads) == expected);
+				assert(valid_solutions(solver.get_solutions(), n, expected));
+			}
+		}
+
+		assert(solver.solve_exact_cover(NQueensSolver::COUNT) == expected);
+		assert(solver.solve_exact_cover(NQueensSolver::FIRST) == min(expected, uint64_t(1)));
+		if (expected) {
+			assert(valid_queens(solver.get_solution().data(), n));
+		}
+		if (n <= 8) {
+			assert(solver.solve_exact_cover(NQueensSolver::ENUMERATE) == expected);
+			assert(valid_solutions(solver.get_solutions(), n, expected));
+		}
+	}
+
+	cout << "Test N-Queens passed!" << endl;
+}
+
+// every row, column and box holds 1 .. 9 and the givens are kept
+bool valid_sudoku(const vector<int>& grid, const vector<int>& givens) {
+	for (int cell = 0; cell < 81; ++ cell) {
+		if (givens[cell] && grid[cell] != givens[cell]) {
+			return false;
+		}
+	}
+	for (int unit = 0; unit < 9; ++ unit) {
+		int seen_row = 0;
+		int seen_col = 0;
+		int seen_box = 0;
+		for (int i = 0; i < 9; ++ i) {
+			int row_digit = grid[unit * 9 + i];
+			int col_digit = grid[i * 9 + unit];
+			int box_digit = grid[(unit / 3 * 3 + i / 3) * 9 + unit % 3 * 3 + i % 3];
+			seen_row |= 1 << row_digit;
+			seen_col |= 1 << col_digit;
+			seen_box |= 1 << box_digit;
+		}
+		// bits 1 .. 9
+		if (seen_row != 0x3fe || seen_col != 0x3fe || seen_box != 0x3fe) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void test_sudoku() {
+	vector<int> givens = {
+		5, 3, 0, 0, 7, 0, 0, 0, 0,
+		6, 0, 0, 1, 9, 5, 0, 0, 0,
+		0, 9, 8, 0, 0, 0, 0, 6, 0,
+		8, 0, 0, 0, 6, 0, 0, 0, 3,
+		4, 0, 0, 8, 0, 3, 0, 0, 1,
+		7, 0, 0, 0, 2, 0, 0, 0, 6,
+		0, 6, 0, 0, 0, 0, 2, 8, 0,
+		0, 0, 0, 4, 1, 9, 0, 0, 5,
+		0, 0, 0, 0, 8, 0, 0, 7, 9
+	};
+	vector<int> grid = givens;
+	assert(SudokuSolver().solve(grid));
+	assert(valid_sudoku(grid, givens));
+
+	// an empty grid has solutions too
+	vector<int> blank(81, 0);
+	grid = blank;
+	assert(SudokuSolver().solve(grid));
+	assert(valid_sudoku(grid, blank));
+
+	// two 5s in the first row, left untouched
+	vector<int> broken = givens;
+	broken[2] = 5;
+	grid = broken;
+	assert(!SudokuSolver().solve(grid));
+	assert(grid == broken);
+
+	cout << "Test Sudoku passed!" << endl;
+}
+
+// 0/1 knapsack by dynamic programming over capacities
+int64_t knapsack_table(const vector<int64_t>& weights, const vector<int64_t>& values, int64_t capacity) {
+	vector<int64_t> best(capacity + 1, 0);
+	for (size_t i = 0; i < weights.size(); ++ i) {
+		for (int64_t c = capacity; c >= weights[i]; -- c) {
+			best[c] = max(best[c], best[c - weights[i]] + values[i]);
+		}
+	}
+	return best[capacity];
+}
+
+void test_branch_and_bound() {
+	typedef BranchAndBound<KnapsackProblem> Solver;
+	Solver::Strategy strategies[] = { Solver::DEPTH_FIRST, Solver::BEST_FIRST, Solver::HYBRID };
+	int thread_counts[] = { 1, 4 };
+	// a tiny limit forces the depth first fallback
+	size_t open_limits[] = { 4, 1 << 20 };
+
+	unsigned seed = 44;
+	for (int round = 0; round < 200; ++ round) {
+		seed = seed * 1103515245 + 12345;
+		int n = (seed >> 8) % 25;
+		vector<int64_t> weights;
+		vector<int64_t> values;
+		for (int i = 0; i < n; ++ i) {
+			// every fifth instance has zero weight items
+			seed = seed * 1103515245 + 12345;
+			weights.push_back((seed >> 8) % 50 + (round % 5 ? 1 : 0));
+			seed = seed * 1103515245 + 12345;
+			values.push_back((seed >> 8) % 100);
+		}
+		seed = seed * 1103515245 + 12345;
+		int64_t capacity = (seed >> 8) % 300;
+		int64_t expected = knapsack_table(weights, values, capacity);
+
+		KnapsackProblem knapsack(weights, values, capacity);
+		for (Solver::Strategy strategy : strategies) {
+			for (int num_threads : thread_counts) {
+				for (size_t max_open : open_limits) {
+					Solver bnb(knapsack, strategy, max_open);
+					assert(bnb.solve(knapsack.root(), num_threads));
+					assert(bnb.get_value() == expected);
+
+					// the best node is a packing worth the value
+					int64_t weight = 0;
+					int64_t value = 0;
+					for (int item : knapsack.items(bnb.get_best())) {
+						weight += weights[item];
+						value += values[item];
+					}
+					assert(weight <= capacity && value == expected);
+				}
+			}
+		}
+	}
+
+	cout << "Test branch and bound passed!" << endl;
+}
 
 int main(int argc, char *argv[]) {
-	
-	NQueensSolver solver(20);
-	solver.solve();
-	
-}
\ No newline at end of file
+
+	test_nqueens();
+	test_sudoku();
+	test_branch_and_bound();
+
+	int n = argc > 1 ? atoi(argv[1]) : 8;
+	NQueensSolver solver(n);
+
+	if (solver.solve(NQueensSolver::FIRST)) {
+		cout << "First solution:";
+		for (int col : solver.get_solution()) {
+			cout << ' ' << col;
+		}
+		cout << endl;
+	}
+	cout << "Num of solutions: " << solver.solve(NQueensSolver::COUNT) << endl;
+	cout << "Num of solutions in parallel: " << solver.solve_parallel(NQueensSolver::COUNT) << endl;
+
+	cout << "Num of solutions by exact cover: " << solver.solve_exact_cover(NQueensSolver::COUNT) << endl;
+
+	vector<int> sudoku = {
+		5, 3, 0, 0, 7, 0, 0, 0, 0,
+		6, 0, 0, 1, 9, 5, 0, 0, 0,
+		0, 9, 8, 0, 0, 0, 0, 6, 0,
+		8, 0, 0, 0, 6, 0, 0, 0, 3,
+		4, 0, 0, 8, 0, 3, 0, 0, 1,
+		7, 0, 0, 0, 2, 0, 0, 0, 6,
+		0, 6, 0, 0, 0, 0, 2, 8, 0,
+		0, 0, 0, 4, 1, 9, 0, 0, 5,
+		0, 0, 0, 0, 8, 0, 0, 7, 9
+	};
+	if (SudokuSolver().solve(sudoku)) {
+		for (int r = 0; r < 9; ++ r) {
+			for (int c = 0; c < 9; ++ c) {
+				cout << sudoku[r * 9 + c] << (c == 8 ? '\n' : ' ');
+			}
+		}
+	}
+
+	// capacities far beyond what a dp table could hold
+	vector<int64_t> weights = { 10000000000, 20000000000, 30000000000 };
+	vector<int64_t> values = { 60, 100, 120 };
+	KnapsackProblem knapsack(weights, values, 50000000000);
+	BranchAndBound<KnapsackProblem> bnb(knapsack);
+	bnb.solve(knapsack.root());
+	cout << "Knapsack value: " << bnb.get_value() << ", items:";
+	for (int item : knapsack.items(bnb.get_best())) {
+		cout << ' ' << item;
+	}
+	cout << endl;
+
+}
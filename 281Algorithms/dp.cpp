@@ -1,75 +1,957 @@
 #include <iostream>
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cassert>
+#include <new>
+#include <limits>
+#include <utility>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
+// Allocator for cache line aligned arrays
+template <typename T>
+struct Aligned_Allocator {
+	typedef T value_type;
 
-int knapsack(const vector<int>& weights, const vector<int>& values, int capacity) {
-	
-	// init state space
-	// base case 0,0 => 0 included
-	vector<vector<int>> dp(capacity + 1, vector<int>(weights.size() + 1, 0));
-	
-	// recursive case
-	for (int i = 1; i <= capacity; ++ i) {
-		for (int j = 1; j <= (int)weights.size(); ++ j) {
-			// case 1: if able to pick the weight
-			if (weights[j] <= i) {
-				// two choices, pick or not pick, get max
-				dp[i][j] = max(dp[i][j-1], values[j] + dp[i-weights[j]][j]);
+	static const size_t ALIGNMENT = 64;
+
+	Aligned_Allocator() {}
+	template <typename U>
+	Aligned_Allocator(const Aligned_Allocator<U>&) {}
+
+	// over allocate, keep the block's start right before the aligned pointer
+	T* allocate(size_t n) {
+		char* block = static_cast<char*>(::operator new(n * sizeof(T) + ALIGNMENT + sizeof(void*)));
+		uintptr_t aligned = (reinterpret_cast<uintptr_t>(block) + sizeof(void*) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+		reinterpret_cast<void**>(aligned)[-1] = block;
+		return reinterpret_cast<T*>(aligned);
+	}
+
+	void deallocate(T* p, size_t) {
+		::operator delete(reinterpret_cast<void**>(p)[-1]);
+	}
+
+	template <typename U>
+	bool operator==(const Aligned_Allocator<U>&) const {
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const Aligned_Allocator<U>&) const {
+		return false;
+	}
+};
+
+template <typename T>
+using Aligned_Vector = vector<T, Aligned_Allocator<T>>;
+
+// Reusable barrier for a fixed team of threads
+struct Barrier {
+
+	explicit Barrier(int count) : count(count) {}
+
+	void wait() {
+		unique_lock<mutex> guard(this->lock);
+		size_t generation = this->generation;
+		if (++ this->waiting == this->count) {
+			this->waiting = 0;
+			++ this->generation;
+			this->ready.notify_all();
+		} else {
+			this->ready.wait(guard, [this, generation]() { return generation != this->generation; });
+		}
+	}
+
+private:
+	int count;
+	int waiting = 0;
+	size_t generation = 0;
+	mutex lock;
+	condition_variable ready;
+};
+
+// one item over capacities [lo, hi), reading the row before it from
+// prev and writing the new one to next; with separate rows there is
+// no dependence between capacities, so the loop vectorizes
+template <typename Value>
+void knapsack_sweep(const Value* __restrict prev, Value* __restrict next,
+					int lo, int hi, int weight, Value value) {
+	int i = lo;
+	for (; i < hi && i < weight; ++ i) {
+		next[i] = prev[i];
+	}
+	for (; i < hi; ++ i) {
+		// two choices, pick or not pick, get max
+		next[i] = max(prev[i], prev[i - weight] + value);
+	}
+}
+
+#ifdef __AVX2__
+// explicit 8 and 4 lane versions for the common value types
+inline void knapsack_sweep(const int32_t* prev, int32_t* next, int lo, int hi, int weight, int32_t value) {
+	int i = lo;
+	for (; i < hi && i < weight; ++ i) {
+		next[i] = prev[i];
+	}
+	__m256i add = _mm256_set1_epi32(value);
+	for (; i + 8 <= hi; i += 8) {
+		__m256i skip = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i));
+		__m256i pick = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i - weight)), add);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(next + i), _mm256_max_epi32(skip, pick));
+	}
+	for (; i < hi; ++ i) {
+		next[i] = max(prev[i], prev[i - weight] + value);
+	}
+}
+
+inline void knapsack_sweep(const int64_t* prev, int64_t* next, int lo, int hi, int weight, int64_t value) {
+	int i = lo;
+	for (; i < hi && i < weight; ++ i) {
+		next[i] = prev[i];
+	}
+	__m256i add = _mm256_set1_epi64x(value);
+	for (; i + 4 <= hi; i += 4) {
+		__m256i skip = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i));
+		__m256i pick = _mm256_add_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i - weight)), add);
+		// no 64 bit max in AVX2, blend on a compare
+		__m256i max = _mm256_blendv_epi8(skip, pick, _mm256_cmpgt_epi64(pick, skip));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(next + i), max);
+	}
+	for (; i < hi; ++ i) {
+		next[i] = max(prev[i], prev[i - weight] + value);
+	}
+}
+#endif
+
+// fewer capacities than this per thread are not worth a thread
+const int MIN_SWEEP_PER_THREAD = 1 << 16;
+
+
+// best value of items lo .. hi-1 within every capacity 0 .. capacity,
+// two rows swapped after each item; large rows are split into
+// num_threads slices (0 for one per core) that meet at a barrier
+// before the next item reads them
+template <typename Value>
+void knapsack_row(const vector<int>& weights, const vector<Value>& values,
+				  int lo, int hi, int capacity, Aligned_Vector<Value>& dp, int num_threads = 1) {
+	int size = capacity + 1;
+	dp.assign(size, 0);
+	Aligned_Vector<Value> scratch(size);
+	if (num_threads <= 0) {
+		num_threads = (int)thread::hardware_concurrency();
+	}
+	num_threads = max(1, min(num_threads, size / MIN_SWEEP_PER_THREAD));
+
+	if (num_threads == 1) {
+		Value* prev = dp.data();
+		Value* next = scratch.data();
+		for (int j = lo; j < hi; ++ j) {
+			knapsack_sweep(prev, next, 0, size, weights[j], values[j]);
+			swap(prev, next);
+		}
+	} else {
+		Barrier barrier(num_threads);
+		// slices start on cache lines
+		int per_line = int(Aligned_Allocator<Value>::ALIGNMENT / sizeof(Value));
+		int slice = (size / num_threads + per_line - 1) / per_line * per_line;
+		auto sweep_slice = [&](int t) {
+			int slice_lo = min(size, t * slice);
+			int slice_hi = t == num_threads - 1 ? size : min(size, slice_lo + slice);
+			Value* prev = dp.data();
+			Value* next = scratch.data();
+			for (int j = lo; j < hi; ++ j) {
+				knapsack_sweep(prev, next, slice_lo, slice_hi, weights[j], values[j]);
+				barrier.wait();
+				swap(prev, next);
+			}
+		};
+		vector<thread> team;
+		for (int t = 1; t < num_threads; ++ t) {
+			team.emplace_back(sweep_slice, t);
+		}
+		sweep_slice(0);
+		for (thread& worker : team) {
+			worker.join();
+		}
+	}
+
+	// an odd num of items leaves the last row in scratch
+	if ((hi - lo) % 2) {
+		dp.swap(scratch);
+	}
+}
+
+// 0/1 knapsack, O(capacity) memory
+template <typename Value>
+Value knapsack(const vector<int>& weights, const vector<Value>& values, int capacity, int num_threads = 1) {
+	Aligned_Vector<Value> dp;
+	knapsack_row(weights, values, 0, (int)weights.size(), capacity, dp, num_threads);
+	return dp[capacity];
+}
+
+// Hirschberg style: split the items in half, find how the capacity is
+// shared between the halves from a forward and a backward row, then
+// recurse, so only O(capacity) is live at a time
+template <typename Value>
+void knapsack_items(const vector<int>& weights, const vector<Value>& values,
+					int lo, int hi, int capacity, vector<int>& chosen) {
+	if (lo >= hi) {
+		return;
+	}
+	// base case, a single item is taken if it fits and helps
+	if (hi - lo == 1) {
+		if (weights[lo] <= capacity && values[lo] > 0) {
+			chosen.push_back(lo);
+		}
+		return;
+	}
+
+	int mid = lo + (hi - lo) / 2;
+	int split = 0;
+	{
+		Aligned_Vector<Value> front;
+		Aligned_Vector<Value> back;
+		knapsack_row(weights, values, lo, mid, capacity, front);
+		knapsack_row(weights, values, mid, hi, capacity, back);
+		for (int i = 1; i <= capacity; ++ i) {
+			if (front[i] + back[capacity - i] > front[split] + back[capacity - split]) {
+				split = i;
+			}
+		}
+	}
+	knapsack_items(weights, values, lo, mid, split, chosen);
+	knapsack_items(weights, values, mid, hi, capacity - split, chosen);
+}
+
+// same, with the indices of the chosen items in chosen
+template <typename Value>
+Value knapsack(const vector<int>& weights, const vector<Value>& values, int capacity, vector<int>& chosen) {
+	chosen.clear();
+	knapsack_items(weights, values, 0, (int)weights.size(), capacity, chosen);
+	Value total = 0;
+	for (int j : chosen) {
+		total += values[j];
+	}
+	return total;
+}
+
+// bounded knapsack, item j may be taken up to counts[j] times.
+// Capacities with the same remainder mod the weight form a chain, and
+// along a chain the best count of the item is a max over a sliding
+// window of the previous row, kept in a monotone queue, so each item
+// costs O(capacity) whatever its count; Value must hold q * value
+// for q up to capacity / weight
+template <typename Value>
+Value knapsack_bounded(const vector<int>& weights, const vector<Value>& values,
+					   const vector<int>& counts, int capacity) {
+	int size = capacity + 1;
+	Aligned_Vector<Value> prev(size, 0);
+	Aligned_Vector<Value> next(size);
+	// queue of chain positions and their keys, reused by every chain
+	vector<int> window(size);
+	vector<Value> keys(size);
+
+	for (size_t j = 0; j < weights.size(); ++ j) {
+		int weight = weights[j];
+		Value value = values[j];
+		int count = counts[j];
+		assert(weight >= 0 && count >= 0);
+		if (weight == 0) {
+			// every copy is free
+			for (int i = 0; i < size; ++ i) {
+				next[i] = prev[i] + max(Value(0), value * count);
+			}
+		} else {
+			for (int r = 0; r < weight && r < size; ++ r) {
+				int head = 0;
+				int tail = 0;
+				for (int q = 0, i = r; i < size; ++ q, i += weight) {
+					// taking q - t copies on top of position t is worth
+					// prev[t] - t * value + q * value
+					Value key = prev[i] - q * value;
+					while (tail > head && keys[tail - 1] <= key) {
+						-- tail;
+					}
+					window[tail] = q;
+					keys[tail] = key;
+					++ tail;
+					// at most count copies
+					if (window[head] < q - count) {
+						++ head;
+					}
+					next[i] = keys[head] + q * value;
+				}
+			}
+		}
+		prev.swap(next);
+	}
+	return prev[capacity];
+}
+
+// unbounded knapsack, any num of copies of each item, weights > 0.
+// Sweeping up lets dp[i - weight] already hold copies of the item,
+// so a single row is enough
+template <typename Value>
+Value knapsack_unbounded(const vector<int>& weights, const vector<Value>& values, int capacity) {
+	Aligned_Vector<Value> dp(capacity + 1, 0);
+	for (size_t j = 0; j < weights.size(); ++ j) {
+		// a free item would be taken without end
+		assert(weights[j] > 0);
+		for (int i = weights[j]; i <= capacity; ++ i) {
+			dp[i] = max(dp[i], dp[i - weights[j]] + values[j]);
+		}
+	}
+	return dp[capacity];
+}
+
+// bounded knapsack by binary splitting, for comparison: count copies
+// become 0/1 items of 1, 2, 4, .. copies and the rest, which can add
+// up to any count, then the 0/1 sweep runs over them
+template <typename Value>
+Value knapsack_binary(const vector<int>& weights, const vector<Value>& values,
+					  const vector<int>& counts, int capacity) {
+	vector<int> split_weights;
+	vector<Value> split_values;
+	for (size_t j = 0; j < weights.size(); ++ j) {
+		assert(weights[j] >= 0 && counts[j] >= 0);
+		int left = counts[j];
+		for (int copies = 1; left > 0; copies *= 2) {
+			int take = min(copies, left);
+			// bundles heavier than the knapsack never fit
+			if ((long long)take * weights[j] <= capacity) {
+				split_weights.push_back(take * weights[j]);
+				split_values.push_back(take * values[j]);
+			}
+			left -= take;
+		}
+	}
+	return knapsack(split_weights, split_values, capacity);
+}
+
+// (weight, value) of every subset of items lo .. hi-1 in increasing
+// weight, built by merging the list with a shifted copy per item
+template <typename Value>
+vector<pair<int64_t, Value>> knapsack_subsets(const vector<int64_t>& weights, const vector<Value>& values,
+											  int lo, int hi, int64_t capacity) {
+	vector<pair<int64_t, Value>> subsets(1, make_pair(int64_t(0), Value(0)));
+	vector<pair<int64_t, Value>> merged;
+	for (int j = lo; j < hi; ++ j) {
+		merged.clear();
+		size_t a = 0;
+		size_t b = 0;
+		while (a < subsets.size() || b < subsets.size()) {
+			// b walks the copies with item j added, over capacity drops out
+			bool take_b = b < subsets.size() && subsets[b].first + weights[j] <= capacity &&
+				(a == subsets.size() || subsets[b].first + weights[j] < subsets[a].first);
+			if (take_b) {
+				merged.push_back(make_pair(subsets[b].first + weights[j], subsets[b].second + values[j]));
+				++ b;
+			} else if (a < subsets.size()) {
+				merged.push_back(subsets[a ++]);
 			} else {
-				// cant pick, simple inherit the previous value
-				dp[i][j] = dp[i][j-1];
+				break;
 			}
 		}
+		subsets.swap(merged);
 	}
-	
-	return dp[capacity][weights.size()];
+	return subsets;
+}
+
+// exact knapsack by meet in the middle, for up to about 40 items with
+// any capacity: the subsets of each half sorted by weight, the second
+// half pruned to strictly rising values, then the halves are matched
+// with two pointers, heavier first subsets meeting lighter second ones
+template <typename Value>
+Value knapsack_mitm(const vector<int64_t>& weights, const vector<Value>& values, int64_t capacity) {
+	int n = (int)weights.size();
+	vector<pair<int64_t, Value>> first = knapsack_subsets(weights, values, 0, n / 2, capacity);
+	vector<pair<int64_t, Value>> second = knapsack_subsets(weights, values, n / 2, n, capacity);
+
+	// a heavier subset that is worth no more is dominated
+	size_t kept = 0;
+	for (size_t i = 0; i < second.size(); ++ i) {
+		if (kept == 0 || second[i].second > second[kept - 1].second) {
+			second[kept ++] = second[i];
+		}
+	}
+	second.resize(kept);
+
+	Value best = 0;
+	size_t b = second.size();
+	for (size_t a = 0; a < first.size(); ++ a) {
+		while (b > 0 && first[a].first + second[b - 1].first > capacity) {
+			-- b;
+		}
+		if (b == 0) {
+			break;
+		}
+		best = max(best, first[a].second + second[b - 1].second);
+	}
+	return best;
+}
+
+// longest row the table or the value indexed row may take
+const int64_t MAX_KNAPSACK_ROW = int64_t(1) << 26;
+
+// the items FPTAS works on, those that fit and help, with their values
+// scaled down by epsilon * max value / n; returns the sum of the scaled
+// values, the last index of its row, stopping at MAX_KNAPSACK_ROW
+template <typename Value>
+int64_t knapsack_scale(const vector<int64_t>& weights, const vector<Value>& values, int64_t capacity,
+					   double epsilon, vector<int>& items, vector<int64_t>& scaled) {
+	items.clear();
+	scaled.clear();
+	Value max_value = 0;
+	for (size_t j = 0; j < weights.size(); ++ j) {
+		if (weights[j] <= capacity && values[j] > 0) {
+			items.push_back((int)j);
+			max_value = max(max_value, values[j]);
+		}
+	}
+
+	double scale = items.empty() ? 1.0 : max(1.0, epsilon * max_value / items.size());
+	int64_t total = 0;
+	for (int j : items) {
+		scaled.push_back(int64_t(min<double>(values[j] / scale, MAX_KNAPSACK_ROW)));
+		total = min(MAX_KNAPSACK_ROW, total + scaled.back());
+	}
+	return total;
+}
+
+// (1 - epsilon) approximate knapsack for capacities too large for a
+// table: values are scaled down by epsilon * max value / n and a row
+// indexed by scaled value keeps the least weight reaching it, along
+// with the true value of that packing. O(n^3 / epsilon) time and
+// O(n^2 / epsilon) memory; epsilon = 0 keeps values as they are, exact,
+// which only works while the values add up to less than MAX_KNAPSACK_ROW
+template <typename Value>
+Value knapsack_fptas(const vector<int64_t>& weights, const vector<Value>& values, int64_t capacity, double epsilon) {
+	vector<int> items;
+	vector<int64_t> scaled;
+	int64_t total = knapsack_scale(weights, values, capacity, epsilon, items, scaled);
+	// too fine for the values, a larger epsilon shortens the row
+	assert(total < MAX_KNAPSACK_ROW);
+	if (items.empty()) {
+		return 0;
+	}
+
+	const int64_t UNREACHED = numeric_limits<int64_t>::max();
+	Aligned_Vector<int64_t> least_weight(total + 1, UNREACHED);
+	Aligned_Vector<Value> true_value(total + 1, 0);
+	least_weight[0] = 0;
+	for (size_t k = 0; k < items.size(); ++ k) {
+		int64_t weight = weights[items[k]];
+		for (int64_t p = total; p >= scaled[k]; -- p) {
+			int64_t from = least_weight[p - scaled[k]];
+			if (from == UNREACHED || from + weight > capacity) {
+				continue;
+			}
+			// lighter, or as light and worth more before scaling
+			Value value = true_value[p - scaled[k]] + values[items[k]];
+			if (from + weight < least_weight[p] || (from + weight == least_weight[p] && value > true_value[p])) {
+				least_weight[p] = from + weight;
+				true_value[p] = value;
+			}
+		}
+	}
+
+	Value best = 0;
+	for (int64_t p = 0; p <= total; ++ p) {
+		if (least_weight[p] != UNREACHED) {
+			best = max(best, true_value[p]);
+		}
+	}
+	return best;
+}
+
+enum Knapsack_Mode {
+	KNAPSACK_TABLE,		// rolling row over capacity, exact
+	KNAPSACK_MITM,		// meet in the middle, exact
+	KNAPSACK_FPTAS,		// value scaled, within epsilon
+	KNAPSACK_NONE		// none fits, epsilon has to grow
+};
+
+// mode for the input and the precision asked for: the table while it
+// fits, unless the FPTAS row at this epsilon does less work, then meet
+// in the middle, then FPTAS if its row fits. With epsilon = 0 FPTAS is
+// exact and its row as long as the values add up to
+template <typename Value>
+Knapsack_Mode knapsack_mode(const vector<int64_t>& weights, const vector<Value>& values, int64_t capacity,
+							double epsilon = 0) {
+	// most work a table is worth, and the most items meet in the middle takes
+	const double MAX_TABLE_WORK = 1e10;
+	const size_t MAX_MITM = 40;
+	size_t n = weights.size();
+
+	vector<int> items;
+	vector<int64_t> scaled;
+	int64_t fptas_row = knapsack_scale(weights, values, capacity, epsilon, items, scaled) + 1;
+	bool fptas_fits = fptas_row <= MAX_KNAPSACK_ROW;
+	double fptas_work = double(items.size()) * fptas_row;
+
+	double table_work = double(n) * (capacity + 1);
+	if (capacity >= 0 && capacity < MAX_KNAPSACK_ROW && table_work < MAX_TABLE_WORK &&
+		(!fptas_fits || table_work <= fptas_work)) {
+		return KNAPSACK_TABLE;
+	}
+	// exact and at most 2^20 subsets a half
+	if (n <= MAX_MITM) {
+		return KNAPSACK_MITM;
+	}
+	return fptas_fits ? KNAPSACK_FPTAS : KNAPSACK_NONE;
+}
+
+// knapsack for any capacity in the given mode, which has to fit;
+// without epsilon FPTAS runs exact, indexed by value
+template <typename Value>
+Value knapsack_any(const vector<int64_t>& weights, const vector<Value>& values, int64_t capacity,
+				   Knapsack_Mode mode, double epsilon = 0) {
+	assert(mode != KNAPSACK_NONE);
+	if (mode == KNAPSACK_MITM) {
+		return knapsack_mitm(weights, values, capacity);
+	}
+	if (mode == KNAPSACK_FPTAS) {
+		return knapsack_fptas(weights, values, capacity, epsilon);
+	}
+	// a row of capacity + 1, as short as knapsack_mode wants it
+	assert(capacity >= 0 && capacity < MAX_KNAPSACK_ROW);
+	// ones over capacity never fit
+	vector<int> table_weights;
+	vector<Value> table_values;
+	for (size_t j = 0; j < weights.size(); ++ j) {
+		if (weights[j] <= capacity) {
+			table_weights.push_back((int)weights[j]);
+			table_values.push_back(values[j]);
+		}
+	}
+	return knapsack(table_weights, table_values, (int)capacity);
+}
+
+// same in the mode knapsack_mode picks, best is set unless no mode
+// fits at this epsilon, then false comes back
+template <typename Value>
+bool knapsack_any(const vector<int64_t>& weights, const vector<Value>& values, int64_t capacity,
+				  Value& best, double epsilon = 0) {
+	Knapsack_Mode mode = knapsack_mode(weights, values, capacity, epsilon);
+	if (mode == KNAPSACK_NONE) {
+		return false;
+	}
+	best = knapsack_any(weights, values, capacity, mode, epsilon);
+	return true;
+}
+
+// num of set bits
+inline int popcount(uint64_t bits) {
+#ifdef __GNUC__
+	return __builtin_popcountll(bits);
+#else
+	int count = 0;
+	for (; bits; bits &= bits - 1) {
+		++ count;
+	}
+	return count;
+#endif
+}
+
+// length of the longest common subsequence, bit parallel after Hyyro.
+// Bit i of the row is 0 where the LCS of a[0..i] with the part of b
+// seen so far gains a char, each char of b updates 64 bits of a word
+// at a time: with U = V & match, V = (V + U) | (V & ~match), the carry
+// runs one pass over the words. O(|a| |b| / 64) time, O(|a| / 64) row
+int lcs(const string& a, const string& b) {
+	int m = (int)a.length();
+	int words = (m + 63) / 64;
+
+	// match masks, only for the chars that occur in a
+	vector<int> alphabet(256, -1);
+	vector<uint64_t> masks;
+	for (int i = 0; i < m; ++ i) {
+		int& index = alphabet[(unsigned char)a[i]];
+		if (index < 0) {
+			index = (int)(masks.size() / words);
+			masks.resize(masks.size() + words, 0);
+		}
+		masks[index * words + i / 64] |= uint64_t(1) << (i % 64);
+	}
+
+	vector<uint64_t> row(words, ~uint64_t(0));
+	for (char c : b) {
+		int index = alphabet[(unsigned char)c];
+		if (index < 0) {
+			// no match, the row stays
+			continue;
+		}
+		const uint64_t* match = &masks[index * words];
+		uint64_t carry = 0;
+		for (int w = 0; w < words; ++ w) {
+			uint64_t v = row[w];
+			uint64_t u = v & match[w];
+			uint64_t sum = v + u;
+			uint64_t carry_out = sum < v;
+			sum += carry;
+			carry = carry_out | (sum < carry);
+			row[w] = sum | (v & ~match[w]);
+		}
+	}
+
+	// zeros in the first m bits, the ones above never reach them
+	int length = 0;
+	for (int w = 0; w < words; ++ w) {
+		uint64_t bits = row[w];
+		if (w == words - 1 && m % 64) {
+			bits |= ~uint64_t(0) << (m % 64);
+		}
+		length += 64 - popcount(bits);
+	}
+	return length;
 }
 
+// longest palindromic subsequence, the LCS of the string and its reverse
 int lps(const string& str) {
-	
-	// init state space
-	vector<vector<int>> dp(str.length(), vector<int>(str.length(), 0));
-		
-	// base case f(i,i) == 1
-	for (size_t i = 0; i < str.length(); ++ i) {
-		dp[i][i] = 1;
-	}
-		
-	// recursive case
-	for (size_t i = 0; i < str.length()-1; ++ i) {
-		for (size_t j = i; j < str.length(); ++j) {
-			// case 1: i == j => 1
-			if (i == j) {
-				dp[i][j] = 1;
+	return lcs(str, string(str.rbegin(), str.rend()));
+}
+
+// 0/1 knapsack by trying every subset, for checking
+template <typename Value>
+Value knapsack_subsets_brute(const vector<int>& weights, const vector<Value>& values, int capacity) {
+	int n = (int)weights.size();
+	Value best = 0;
+	for (int subset = 0; subset < (1 << n); ++ subset) {
+		long long weight = 0;
+		Value value = 0;
+		for (int j = 0; j < n; ++ j) {
+			if (subset & (1 << j)) {
+				weight += weights[j];
+				value += values[j];
 			}
-			// case 2: j == i + 1 && A[i] == A[j]
-			else if (j == i + 1 && str[i] == str[j]) {
-				dp[i][j] = 2;
+		}
+		if (weight <= capacity) {
+			best = max(best, value);
+		}
+	}
+	return best;
+}
+
+// random items from the repo's LCG, every so often weightless
+// or worth less than nothing
+template <typename Value>
+void random_items(unsigned& seed, int n, int max_weight, vector<int>& weights, vector<Value>& values) {
+	weights.clear();
+	values.clear();
+	for (int j = 0; j < n; ++ j) {
+		seed = seed * 1103515245 + 12345;
+		weights.push_back((seed >> 8) % 8 == 0 ? 0 : (seed >> 11) % max_weight + 1);
+		seed = seed * 1103515245 + 12345;
+		values.push_back(Value((seed >> 8) % 100) - ((seed >> 16) % 8 == 0 ? 50 : 0));
+	}
+}
+
+// chosen items are distinct, fit and add up to value
+template <typename Value>
+bool valid_choice(const vector<int>& weights, const vector<Value>& values, int capacity,
+				  const vector<int>& chosen, Value value) {
+	vector<int> sorted(chosen);
+	sort(sorted.begin(), sorted.end());
+	if (unique(sorted.begin(), sorted.end()) != sorted.end()) {
+		return false;
+	}
+	long long weight = 0;
+	Value total = 0;
+	for (int j : chosen) {
+		weight += weights[j];
+		total += values[j];
+	}
+	return weight <= capacity && total == value;
+}
+
+template <typename Value>
+void test_knapsack_values() {
+	unsigned seed = 46;
+	vector<int> weights;
+	vector<Value> values;
+	vector<int> chosen;
+	for (int round = 0; round < 300; ++ round) {
+		seed = seed * 1103515245 + 12345;
+		int n = (seed >> 8) % 13;
+		random_items(seed, n, 60, weights, values);
+		seed = seed * 1103515245 + 12345;
+		int capacity = (seed >> 8) % 200;
+
+		Value expected = knapsack_subsets_brute(weights, values, capacity);
+		assert(knapsack(weights, values, capacity) == expected);
+		assert(knapsack(weights, values, capacity, chosen) == expected);
+		assert(valid_choice(weights, values, capacity, chosen, expected));
+	}
+}
+
+void test_knapsack() {
+	vector<int> weights = {10, 20, 30};
+	vector<int> values = {60, 100, 120};
+	vector<int> chosen;
+	assert(knapsack(weights, values, 50) == 220);
+	assert(knapsack(weights, values, 50, chosen) == 220);
+	assert(chosen == vector<int>({1, 2}));
+	assert(knapsack(weights, values, 0, chosen) == 0 && chosen.empty());
+
+	// both vectorized value types and a generic one
+	test_knapsack_values<int32_t>();
+	test_knapsack_values<int64_t>();
+	test_knapsack_values<double>();
+
+	cout << "Test knapsack passed!" << endl;
+}
+
+template <typename Value>
+void test_knapsack_threads_values() {
+	// wide enough for 4 slices of MIN_SWEEP_PER_THREAD
+	const int capacity = 4 * MIN_SWEEP_PER_THREAD + 1000;
+	unsigned seed = 47;
+	vector<int> weights;
+	vector<Value> values;
+	Aligned_Vector<Value> single;
+	Aligned_Vector<Value> sliced;
+	for (int round = 0; round < 4; ++ round) {
+		// odd and even item counts end in either row
+		random_items(seed, 11 + round, capacity / 3, weights, values);
+
+		Value expected = knapsack_subsets_brute(weights, values, capacity);
+		assert(knapsack(weights, values, capacity) == expected);
+		assert(knapsack(weights, values, capacity, 4) == expected);
+		assert(knapsack(weights, values, capacity, 0) == expected);
+
+		// every capacity of the row, not just the last
+		knapsack_row(weights, values, 0, (int)weights.size(), capacity, single, 1);
+		knapsack_row(weights, values, 0, (int)weights.size(), capacity, sliced, 3);
+		assert(equal(single.begin(), single.end(), sliced.begin()));
+	}
+}
+
+void test_knapsack_threads() {
+	test_knapsack_threads_values<int32_t>();
+	test_knapsack_threads_values<int64_t>();
+
+	cout << "Test knapsack threads passed!" << endl;
+}
+
+void test_knapsack_variants() {
+	unsigned seed = 48;
+	vector<int> weights;
+	vector<int64_t> values;
+	vector<int> counts;
+	for (int round = 0; round < 300; ++ round) {
+		seed = seed * 1103515245 + 12345;
+		int n = (seed >> 8) % 8;
+		random_items(seed, n, 40, weights, values);
+		counts.clear();
+		for (int j = 0; j < n; ++ j) {
+			seed = seed * 1103515245 + 12345;
+			counts.push_back((seed >> 8) % 7);
+		}
+		seed = seed * 1103515245 + 12345;
+		int capacity = (seed >> 8) % 300;
+
+		// every copy as a 0/1 item of its own
+		vector<int> copy_weights;
+		vector<int64_t> copy_values;
+		for (int j = 0; j < n; ++ j) {
+			for (int c = 0; c < counts[j]; ++ c) {
+				copy_weights.push_back(weights[j]);
+				copy_values.push_back(values[j]);
 			}
-			// case 3: A[i] != A[j]
-			else if (str[i] != str[j]) {
-				dp[i][j] = max(dp[i+1][j], dp[i][j-1]);
+		}
+		int64_t expected = knapsack(copy_weights, copy_values, capacity);
+		assert(knapsack_bounded(weights, values, counts, capacity) == expected);
+		assert(knapsack_binary(weights, values, counts, capacity) == expected);
+
+		// unbounded is bounded by as many copies as fit, weights > 0
+		vector<int> heavy_weights;
+		vector<int64_t> heavy_values;
+		vector<int> fits;
+		for (int j = 0; j < n; ++ j) {
+			if (weights[j] > 0) {
+				heavy_weights.push_back(weights[j]);
+				heavy_values.push_back(values[j]);
+				fits.push_back(capacity / weights[j]);
 			}
-			// case 4: A[i] == A[j]
-			else if (str[i] == str[j]){
-				dp[i][j] = 2 + dp[i-1][j-1];
+		}
+		assert(knapsack_unbounded(heavy_weights, heavy_values, capacity) ==
+			   knapsack_bounded(heavy_weights, heavy_values, fits, capacity));
+	}
+
+	vector<int> example_weights = {10, 20, 30};
+	vector<int> example_values = {60, 100, 120};
+	vector<int> example_counts = {3, 1, 2};
+	assert(knapsack_bounded(example_weights, example_values, example_counts, 50) == 280);
+	assert(knapsack_binary(example_weights, example_values, example_counts, 50) == 280);
+	assert(knapsack_unbounded(example_weights, example_values, 50) == 300);
+
+	cout << "Test knapsack variants passed!" << endl;
+}
+
+void test_knapsack_modes() {
+	// exact while it fits, meet in the middle for few items,
+	// FPTAS only when its row at this epsilon is short
+	const int64_t HUGE_CAPACITY = int64_t(1) << 40;
+	vector<int64_t> weights(100, 10);
+	vector<int64_t> values(100, 1000000);
+	assert(knapsack_mode(weights, values, 1000) == KNAPSACK_TABLE);
+	assert(knapsack_mode(weights, values, 1000, 0.1) == KNAPSACK_TABLE);
+	// the exact value row would be 10^8 long
+	assert(knapsack_mode(weights, values, HUGE_CAPACITY) == KNAPSACK_NONE);
+	assert(knapsack_mode(weights, values, HUGE_CAPACITY, 0.1) == KNAPSACK_FPTAS);
+	int64_t best = -1;
+	assert(!knapsack_any(weights, values, HUGE_CAPACITY, best) && best == -1);
+	assert(knapsack_any(weights, values, HUGE_CAPACITY, best, 0.1) && best == 100000000);
+
+	weights.assign(40, 10);
+	values.assign(40, 1000000);
+	assert(knapsack_mode(weights, values, HUGE_CAPACITY) == KNAPSACK_MITM);
+	assert(knapsack_mode(weights, values, HUGE_CAPACITY, 0.1) == KNAPSACK_MITM);
+
+	// a table too much work for its width, small values keep FPTAS exact
+	weights.assign(1000, 10);
+	values.assign(1000, 100);
+	assert(knapsack_mode(weights, values, 1 << 25) == KNAPSACK_FPTAS);
+	assert(knapsack_mode(weights, values, 1 << 25, 0.5) == KNAPSACK_FPTAS);
+
+	unsigned seed = 49;
+	double epsilons[] = { 0.5, 0.2, 0.1, 0.01 };
+	for (int round = 0; round < 200; ++ round) {
+		seed = seed * 1103515245 + 12345;
+		int n = (seed >> 8) % 30;
+		weights.clear();
+		values.clear();
+		for (int j = 0; j < n; ++ j) {
+			seed = seed * 1103515245 + 12345;
+			weights.push_back((seed >> 8) % 1000);
+			seed = seed * 1103515245 + 12345;
+			values.push_back(int64_t((seed >> 8) % 10000) - 100);
+		}
+		seed = seed * 1103515245 + 12345;
+		int64_t capacity = (seed >> 8) % 10000;
+
+		int64_t expected = knapsack_any(weights, values, capacity, KNAPSACK_TABLE);
+		assert(knapsack_any(weights, values, capacity, KNAPSACK_MITM) == expected);
+		assert(knapsack_any(weights, values, capacity, KNAPSACK_FPTAS) == expected);
+		assert(knapsack_any(weights, values, capacity, best) && best == expected);
+		for (double epsilon : epsilons) {
+			int64_t approx = knapsack_any(weights, values, capacity, KNAPSACK_FPTAS, epsilon);
+			assert(approx <= expected && approx >= (1 - epsilon) * expected);
+		}
+	}
+
+	// no table fits and too many items to meet in the middle,
+	// small values keep the exact value row short; any half of
+	// the items fits, so the best are the 50 most valuable
+	weights.assign(100, 10000000000);
+	values.clear();
+	for (int j = 0; j < 100; ++ j) {
+		values.push_back((j * 37) % 100);
+	}
+	int64_t capacity = 50 * weights[0];
+	vector<int64_t> sorted(values);
+	sort(sorted.rbegin(), sorted.rend());
+	int64_t expected = 0;
+	for (int j = 0; j < 50; ++ j) {
+		expected += sorted[j];
+	}
+	assert(knapsack_mode(weights, values, capacity) == KNAPSACK_FPTAS);
+	assert(knapsack_any(weights, values, capacity, best) && best == expected);
+	assert(knapsack_any(weights, values, capacity, best, 0.1) && best >= 0.9 * expected);
+
+	cout << "Test knapsack modes passed!" << endl;
+}
+
+// LCS by the quadratic table, for checking
+int lcs_table(const string& a, const string& b) {
+	vector<vector<int>> table(a.length() + 1, vector<int>(b.length() + 1, 0));
+	for (size_t i = 1; i <= a.length(); ++ i) {
+		for (size_t j = 1; j <= b.length(); ++ j) {
+			if (a[i - 1] == b[j - 1]) {
+				table[i][j] = table[i - 1][j - 1] + 1;
+			} else {
+				table[i][j] = max(table[i - 1][j], table[i][j - 1]);
 			}
 		}
 	}
-	
-	return dp[0][str.length()-1];
-	
+	return table[a.length()][b.length()];
+}
+
+void test_lcs() {
+	assert(lcs("", "") == 0);
+	assert(lcs("", "abc") == 0);
+	assert(lcs("abc", "") == 0);
+	assert(lps("") == 0);
+	assert(lps("GEEKSFORGEEKS") == 5);
+
+	// around the word boundaries, small alphabets and high bytes
+	int lengths[] = { 0, 1, 63, 64, 65, 127, 128, 130, 200 };
+	int alphabets[] = { 2, 4, 26 };
+	unsigned seed = 50;
+	for (int m : lengths) {
+		for (int n : lengths) {
+			for (int alphabet : alphabets) {
+				string a;
+				string b;
+				for (int i = 0; i < m; ++ i) {
+					seed = seed * 1103515245 + 12345;
+					a += char(0x7f + (seed >> 8) % alphabet);
+				}
+				for (int i = 0; i < n; ++ i) {
+					seed = seed * 1103515245 + 12345;
+					b += char(0x7f + (seed >> 8) % alphabet);
+				}
+				assert(lcs(a, b) == lcs_table(a, b));
+				assert(lps(a) == lcs_table(a, string(a.rbegin(), a.rend())));
+			}
+		}
+	}
+
+	cout << "Test lcs passed!" << endl;
 }
 
 int main() {
 	
-//	vector<int> weights = {10, 20, 30};
-//	vector<int> values = {60, 100, 120};
-//	int capacity = 50;
-//		
-//	cout << knapsack(weights, values, capacity);
+	test_knapsack();
+	test_knapsack_threads();
+	test_knapsack_variants();
+	test_knapsack_modes();
+	test_lcs();
+
+	
+	vector<int> weights = {10, 20, 30};
+	vector<int> values = {60, 100, 120};
+	int capacity = 50;
+	vector<int> chosen;
+
+	cout << knapsack(weights, values, capacity, chosen) << endl;
+	for (int j : chosen) {
+		cout << j << ' ';
+	}
+	cout << endl;
+
+	// with multiplicities
+	vector<int> counts = {3, 1, 2};
+	cout << knapsack_bounded(weights, values, counts, capacity) << endl;
+	cout << knapsack_unbounded(weights, values, capacity) << endl;
+
+	// capacities no table can hold
+	vector<int64_t> big_weights = {10000000000, 20000000000, 30000000000};
+	vector<int64_t> big_values = {60, 100, 120};
+	int64_t big_best;
+	if (knapsack_any(big_weights, big_values, 50000000000, big_best)) {
+		cout << big_best << endl;
+	}
+	cout << knapsack_any(big_weights, big_values, 50000000000, KNAPSACK_FPTAS, 0.1) << endl;
 
 	string str = "GEEKSFORGEEKS";
 	cout << lps(str) << endl;
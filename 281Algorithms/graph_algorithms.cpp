@@ -1,10 +1,21 @@
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <cassert>
 #include <limits>
 #include <stack>
 #include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <iterator>
 
 using namespace std;
 
@@ -112,12 +123,119 @@ public:
     // Mode types
     enum Mode { ADJ_MATRIX, ADJ_LIST, BOTH };
     
+private:
+    // a row or chunk of edges shared between copies of a graph,
+    // only the graph whose stamp it carries may write it in place
+    template <typename T>
+    struct Shared {
+        shared_ptr<T> data;
+        uint64_t stamp;
+    };
+    
 public:
+    // edges <from, to, weight> in the order they were added,
+    // kept in chunks that copies of the graph share
+    class Edge_List {
+    public:
+        class const_iterator {
+        public:
+            typedef forward_iterator_tag iterator_category;
+            typedef vector<int> value_type;
+            typedef ptrdiff_t difference_type;
+            typedef const vector<int>* pointer;
+            typedef const vector<int>& reference;
+            
+            const_iterator(const Edge_List* list, size_t pos) : list(list), pos(pos) {}
+            
+            reference operator*() const {
+                return (*this->list)[this->pos];
+            }
+            
+            pointer operator->() const {
+                return &(*this->list)[this->pos];
+            }
+            
+            const_iterator& operator++() {
+                ++ this->pos;
+                return *this;
+            }
+            
+            const_iterator operator++(int) {
+                const_iterator result = *this;
+                ++ this->pos;
+                return result;
+            }
+            
+            bool operator==(const const_iterator& rhs) const {
+                return this->pos == rhs.pos;
+            }
+            
+            bool operator!=(const const_iterator& rhs) const {
+                return this->pos != rhs.pos;
+            }
+            
+        private:
+            const Edge_List* list;
+            size_t pos;
+        };
+        
+        size_t size() const {
+            return this->count;
+        }
+        
+        bool empty() const {
+            return this->count == 0;
+        }
+        
+        const vector<int>& operator[](size_t pos) const {
+            return (*this->chunks[pos / CHUNK_SIZE].data)[pos % CHUNK_SIZE];
+        }
+        
+        const_iterator begin() const {
+            return const_iterator(this, 0);
+        }
+        
+        const_iterator end() const {
+            return const_iterator(this, this->count);
+        }
+        
+    private:
+        friend class Graph;
+        // edges per chunk, a copy of the graph copies one pointer per chunk
+        static const size_t CHUNK_SIZE = 256;
+        vector<Shared<vector<vector<int>>>> chunks;
+        size_t count = 0;
+    };
+    
+    Graph() {}
+    
+    // copies share rows and edges with the original,
+    // from then on neither writes the shared ones in place
+    Graph(const Graph& rhs) {
+        *this = rhs;
+    }
+    
+    Graph& operator=(const Graph& rhs) {
+        if (this != &rhs) {
+            this->mode = rhs.mode;
+            this->revision = rhs.revision;
+            this->num_vertices = rhs.num_vertices;
+            this->is_directed = rhs.is_directed;
+            this->adj_matrix = rhs.adj_matrix;
+            this->adj_list = rhs.adj_list;
+            this->edges = rhs.edges;
+        }
+        // rows stamped before the copy belong to neither graph
+        rhs.stamp = next_id();
+        this->stamp = next_id();
+        return *this;
+    }
     
     // set num vertices
     // REQUIRED
     void set_num_vertices(int num) {
         this->num_vertices = num;
+        this->touch();
     }
     
     // get num vertices
@@ -125,13 +243,14 @@ public:
         return this->num_vertices;
     }
     
-    const vector<vector<int>>& get_edges() const {
+    const Edge_List& get_edges() const {
         return this->edges;
     }
     
     // set whether the graph is directed or not
     void set_directed(bool directed) {
         this->is_directed = directed;
+        this->touch();
     }
     
     // check whether the graph is directed or not
@@ -144,12 +263,16 @@ public:
         assert(this->num_vertices != -1);
         
         this->mode = mode;
+        this->touch();
+        // every row starts as the same empty row, owned by nobody
         if (this->mode == ADJ_LIST || this->mode == BOTH) {
-            this->adj_list.resize(this->num_vertices);
+            Shared<vector<pair<int, int>>> empty = { make_shared<vector<pair<int, int>>>(), 0 };
+            this->adj_list.resize(this->num_vertices, empty);
         }
         if (this->mode == ADJ_MATRIX || this->mode == BOTH) {
             // init with V by V matrix
-            this->adj_matrix.resize(this->num_vertices, vector<int>(this->num_vertices, -1));
+            Shared<vector<int>> empty = { make_shared<vector<int>>(this->num_vertices, -1), 0 };
+            this->adj_matrix.resize(this->num_vertices, empty);
         }
     }
     
@@ -158,21 +281,35 @@ public:
         assert(this->num_vertices != -1);
         
         if (this->mode == ADJ_LIST || this->mode == BOTH) {
-            this->adj_list[from].push_back(pair<int, int>(to, weight));
+            this->own(this->adj_list[from]).push_back(pair<int, int>(to, weight));
             if (!this->is_directed) {
                 // not directed, add the edge in reverse relationship
-                this->adj_list[to].push_back(pair<int, int>(from, weight));
+                this->own(this->adj_list[to]).push_back(pair<int, int>(from, weight));
             }
         }
         if (this->mode == ADJ_MATRIX || this->mode == BOTH) {
-            this->adj_matrix[from][to] = weight;
+            this->own(this->adj_matrix[from])[to] = weight;
             if (!this->is_directed) {
                 // not directed, same thing
-                this->adj_matrix[to][from] = weight;
+                this->own(this->adj_matrix[to])[from] = weight;
             }
         }
         
-        this->edges.push_back(vector<int>({from, to, weight}));
+        // append to the last chunk, or start a new one
+        if (this->edges.count % Edge_List::CHUNK_SIZE == 0) {
+            Shared<vector<vector<int>>> chunk = { make_shared<vector<vector<int>>>(), this->stamp };
+            chunk.data->reserve(Edge_List::CHUNK_SIZE);
+            this->edges.chunks.push_back(chunk);
+        }
+        this->own(this->edges.chunks.back()).push_back(vector<int>({from, to, weight}));
+        ++ this->edges.count;
+        this->touch();
+    }
+    
+    // stamp of the contents, unique across graphs and renewed by every
+    // change; copies keep it, so snapshots can be reused while it matches
+    uint64_t get_revision() const {
+        return this->revision;
     }
     
     // fetch weight/distance between two vertices
@@ -182,11 +319,11 @@ public:
         
         // fast retrieval if in ADJ_MATRIX or BOTH mode
         if (this->mode == ADJ_MATRIX || this->mode == BOTH) {
-            return this->adj_matrix[from][to];
+            return (*this->adj_matrix[from].data)[to];
         }
         
         // otherwise in ADJ_LIST, do a linear traversal
-        for (auto neighbour : this->adj_list[from]) {
+        for (auto neighbour : *this->adj_list[from].data) {
             if (neighbour.first == to) {
                 return neighbour.second;
             }
@@ -200,34 +337,61 @@ public:
     Adj_Iterator adj_begin(int current_vertex) const {
         // fast walk through if use list or both mode
         if (this->mode == ADJ_LIST || this->mode == BOTH) {
-            return Adj_Iterator(this->adj_list[current_vertex].begin(), &(this->adj_list[current_vertex]));
+            return Adj_Iterator(this->adj_list[current_vertex].data->begin(), this->adj_list[current_vertex].data.get());
         }
         // fallback to matrix
-        return Adj_Iterator(this->adj_matrix[current_vertex].begin(), &(this->adj_matrix[current_vertex]));
+        return Adj_Iterator(this->adj_matrix[current_vertex].data->begin(), this->adj_matrix[current_vertex].data.get());
     }
     
     Adj_Iterator adj_end(int current_vertex) const {
         // fast walk through if use list or both mode
         if (this->mode == ADJ_LIST || this->mode == BOTH) {
-            return Adj_Iterator(this->adj_list[current_vertex].end(), &(this->adj_list[current_vertex]));
+            return Adj_Iterator(this->adj_list[current_vertex].data->end(), this->adj_list[current_vertex].data.get());
         }
         // fallback to matrix
-        return Adj_Iterator(this->adj_matrix[current_vertex].end(), &(this->adj_matrix[current_vertex]));
+        return Adj_Iterator(this->adj_matrix[current_vertex].data->end(), this->adj_matrix[current_vertex].data.get());
     }
     
 private:
+    // clone a row or chunk this graph does not own before writing it,
+    // the clone carries our stamp and is written in place from then on
+    template <typename T>
+    T& own(Shared<T>& shared) {
+        uint64_t stamp = this->stamp.load(memory_order_relaxed);
+        if (shared.stamp != stamp) {
+            shared.data = make_shared<T>(*shared.data);
+            shared.stamp = stamp;
+        }
+        return *shared.data;
+    }
+    
+    // unique ids for revisions and stamps
+    static uint64_t next_id() {
+        static atomic<uint64_t> counter(0);
+        return ++ counter;
+    }
+    
+    void touch() {
+        this->revision = next_id();
+    }
+    
     // mode for representation
     Mode mode;
+    // contents stamp
+    uint64_t revision = next_id();
+    // rows and chunks carrying this stamp are ours alone, renewed on copy;
+    // atomic since copying a const graph renews it too
+    mutable atomic<uint64_t> stamp{next_id()};
     // num vertices
     int num_vertices = -1;
     // directed
     bool is_directed = false;
-    // for adj matrix
-    vector<vector<int>> adj_matrix;
-    // for adj list, <vertexId, weight> pair
-    vector<vector<pair<int, int>>> adj_list;
-    // edges as a dedicated vector <from, to, weight>
-    vector<vector<int>> edges;
+    // for adj matrix, copies of the graph share unchanged rows
+    vector<Shared<vector<int>>> adj_matrix;
+    // for adj list, <vertexId, weight> pair, rows shared the same way
+    vector<Shared<vector<pair<int, int>>>> adj_list;
+    // edges as a dedicated list <from, to, weight>
+    Edge_List edges;
     
 };
 
@@ -272,6 +436,11 @@ public:
         return this->weight;
     }
     
+    // get generated path, vertices in the order they joined the tree
+    const vector<int>& get_path() const {
+        return this->path;
+    }
+    
     // print generated path
     void print_path() const {
         for (auto i : this->path) {
@@ -438,7 +607,7 @@ public:
     // build the MST
     void build(const Graph& graph) {
         // sort edges
-        auto edges = graph.get_edges();
+        vector<vector<int>> edges(graph.get_edges().begin(), graph.get_edges().end());
         sort(edges.begin(), edges.end(), [](
                                             const vector<int>& a,
                                             const vector<int>& b
@@ -476,6 +645,11 @@ public:
         return this->weight;
     }
     
+    // get generated path, edges in the order they were picked
+    const vector<pair<int, int>>& get_path() const {
+        return this->path;
+    }
+    
     // print generated path
     void print_path() const {
         for (auto i : this->path) {
@@ -517,6 +691,18 @@ public:
         return this->dists[from];
     }
     
+    // write generated path from start to destination into path,
+    // which keeps its capacity across calls
+    void get_path(vector<int>& path) const {
+        path.clear();
+        int current = this->start;
+        while (this->prevs[current] != -1) {
+            path.push_back(current);
+            current = this->prevs[current];
+        }
+        path.push_back(current);
+    }
+    
     // print generated path
     void print_path() const {
         int current = this->start;
@@ -619,6 +805,344 @@ private:
     }
 };
 
+// Stack frame for explicit stack DFS,
+// a vertex and the adjacent vertices left to walk
+struct DFS_Frame {
+    DFS_Frame(const Graph& graph, int vertex)
+    : vertex(vertex), it(graph.adj_begin(vertex)), it_end(graph.adj_end(vertex)) {}
+    
+    int vertex;
+    Graph::Adj_Iterator it;
+    Graph::Adj_Iterator it_end;
+};
+
+// DFS driven by an explicit stack instead of recursion,
+// so arbitrarily deep graphs cannot overflow the call stack
+class DFS_Iterative {
+public:
+    
+    // Tarjan's strongly connected components
+    // return number of components, ids come out in reverse topological order
+    int strongly_connected_components(const Graph& graph) {
+        int num_vertices = graph.get_num_vertices();
+        this->components.assign(num_vertices, -1);
+        vector<int> index(num_vertices, -1);
+        vector<int> low(num_vertices, 0);
+        vector<bool> on_stack(num_vertices, false);
+        vector<int> scc_stack;
+        vector<DFS_Frame> frames;
+        int counter = 0;
+        int num_components = 0;
+        
+        for (int source = 0; source < num_vertices; ++ source) {
+            if (index[source] != -1) {
+                continue;
+            }
+            // visit source
+            index[source] = low[source] = counter ++;
+            scc_stack.push_back(source);
+            on_stack[source] = true;
+            frames.push_back(DFS_Frame(graph, source));
+            
+            while (!frames.empty()) {
+                DFS_Frame& frame = frames.back();
+                int current = frame.vertex;
+                
+                if (frame.it != frame.it_end) {
+                    int next = *frame.it;
+                    ++ frame.it;
+                    if (index[next] == -1) {
+                        // tree edge, descend
+                        index[next] = low[next] = counter ++;
+                        scc_stack.push_back(next);
+                        on_stack[next] = true;
+                        frames.push_back(DFS_Frame(graph, next));
+                    } else if (on_stack[next]) {
+                        low[current] = min(low[current], index[next]);
+                    }
+                    continue;
+                }
+                
+                // all adjacent vertices done, current is finished
+                frames.pop_back();
+                if (low[current] == index[current]) {
+                    // current is the root of a component, pop it off
+                    int member;
+                    do {
+                        member = scc_stack.back();
+                        scc_stack.pop_back();
+                        on_stack[member] = false;
+                        this->components[member] = num_components;
+                    } while (member != current);
+                    ++ num_components;
+                }
+                // propagate low link to the caller
+                if (!frames.empty()) {
+                    int parent = frames.back().vertex;
+                    low[parent] = min(low[parent], low[current]);
+                }
+            }
+        }
+        
+        return num_components;
+    }
+    
+    // component id per vertex from the last SCC run
+    const vector<int>& get_components() const {
+        return this->components;
+    }
+    
+    // topological order through DFS finishing times
+    // return false if the graph has a cycle
+    bool topological_sort(const Graph& graph) {
+        
+        // only meaningful for directed graphs
+        assert(graph.get_directed());
+        
+        this->order.clear();
+        if (!this->run_directed(graph, &this->order)) {
+            this->order.clear();
+            return false;
+        }
+        reverse(this->order.begin(), this->order.end());
+        return true;
+    }
+    
+    // vertices in topological order from the last sort
+    const vector<int>& get_order() const {
+        return this->order;
+    }
+    
+    // check for cycles reachable from any vertex
+    bool has_cycle(const Graph& graph) {
+        if (graph.get_directed()) {
+            return !this->run_directed(graph, nullptr);
+        }
+        return this->has_cycle_undirected(graph);
+    }
+    
+private:
+    // component id per vertex
+    vector<int> components;
+    // topological order
+    vector<int> order;
+    
+    // three color DFS over a directed graph,
+    // optionally recording finishing order
+    // return false once a back edge is found
+    bool run_directed(const Graph& graph, vector<int>* finished) {
+        // 0 - unvisited, 1 - on the stack, 2 - finished
+        vector<char> color(graph.get_num_vertices(), 0);
+        vector<DFS_Frame> frames;
+        
+        for (int source = 0; source < graph.get_num_vertices(); ++ source) {
+            if (color[source] != 0) {
+                continue;
+            }
+            color[source] = 1;
+            frames.push_back(DFS_Frame(graph, source));
+            
+            while (!frames.empty()) {
+                DFS_Frame& frame = frames.back();
+                if (frame.it != frame.it_end) {
+                    int next = *frame.it;
+                    ++ frame.it;
+                    // back edge into the current path
+                    if (color[next] == 1) {
+                        return false;
+                    }
+                    if (color[next] == 0) {
+                        color[next] = 1;
+                        frames.push_back(DFS_Frame(graph, next));
+                    }
+                    continue;
+                }
+                color[frame.vertex] = 2;
+                if (finished) {
+                    finished->push_back(frame.vertex);
+                }
+                frames.pop_back();
+            }
+        }
+        
+        return true;
+    }
+    
+    // undirected graphs have a cycle once a visited vertex
+    // is reached other than through the edge we came from
+    bool has_cycle_undirected(const Graph& graph) {
+        int num_vertices = graph.get_num_vertices();
+        vector<bool> visited(num_vertices, false);
+        vector<int> parents(num_vertices, -1);
+        // the edge back to the parent may be skipped once,
+        // a second one is a parallel edge and thus a cycle
+        vector<bool> parent_skipped(num_vertices, false);
+        vector<DFS_Frame> frames;
+        
+        for (int source = 0; source < num_vertices; ++ source) {
+            if (visited[source]) {
+                continue;
+            }
+            visited[source] = true;
+            frames.push_back(DFS_Frame(graph, source));
+            
+            while (!frames.empty()) {
+                DFS_Frame& frame = frames.back();
+                int current = frame.vertex;
+                if (frame.it == frame.it_end) {
+                    frames.pop_back();
+                    continue;
+                }
+                int next = *frame.it;
+                ++ frame.it;
+                
+                if (next == parents[current] && !parent_skipped[current]) {
+                    parent_skipped[current] = true;
+                } else if (visited[next]) {
+                    return true;
+                } else {
+                    visited[next] = true;
+                    parents[next] = current;
+                    frames.push_back(DFS_Frame(graph, next));
+                }
+            }
+        }
+        
+        return false;
+    }
+};
+
+// Visitor with every traversal hook as a no-op,
+// derive and shadow the hooks you need.
+// Every hook returns whether the traversal should keep going
+struct Default_Visitor {
+    // vertex seen for the first time
+    bool discover_vertex(int) { return true; }
+    // edge about to be looked at
+    bool examine_edge(int, int) { return true; }
+    // edge leading to a newly discovered vertex
+    bool tree_edge(int, int) { return true; }
+    // all adjacent vertices handled
+    bool finish_vertex(int) { return true; }
+};
+
+// BFS/DFS that stream events to a visitor instead of
+// materializing paths, scratch buffers are reused across runs
+class Traversal {
+public:
+    
+    // BFS from source
+    // return false if the visitor stopped it early
+    template <typename Visitor>
+    bool bfs(const Graph& graph, int source, Visitor& visitor) {
+        this->reset(graph);
+        
+        // visit source
+        this->visited[source] = true;
+        this->queue.push_back(source);
+        if (!visitor.discover_vertex(source)) {
+            return false;
+        }
+        
+        // the queue vector is never popped, head walks it instead
+        for (size_t head = 0; head < this->queue.size(); ++ head) {
+            int current = this->queue[head];
+            auto it = graph.adj_begin(current);
+            auto it_end = graph.adj_end(current);
+            while (it != it_end) {
+                int next = *it;
+                if (!visitor.examine_edge(current, next)) {
+                    return false;
+                }
+                if (!this->visited[next]) {
+                    this->visited[next] = true;
+                    this->queue.push_back(next);
+                    if (!visitor.tree_edge(current, next) || !visitor.discover_vertex(next)) {
+                        return false;
+                    }
+                }
+                ++ it;
+            }
+            if (!visitor.finish_vertex(current)) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    // DFS from source using an explicit stack
+    // return false if the visitor stopped it early
+    template <typename Visitor>
+    bool dfs(const Graph& graph, int source, Visitor& visitor) {
+        this->reset(graph);
+        
+        // visit source
+        this->visited[source] = true;
+        if (!visitor.discover_vertex(source)) {
+            return false;
+        }
+        this->frames.push_back(DFS_Frame(graph, source));
+        
+        while (!this->frames.empty()) {
+            DFS_Frame& frame = this->frames.back();
+            int current = frame.vertex;
+            if (frame.it == frame.it_end) {
+                this->frames.pop_back();
+                if (!visitor.finish_vertex(current)) {
+                    return false;
+                }
+                continue;
+            }
+            int next = *frame.it;
+            ++ frame.it;
+            
+            if (!visitor.examine_edge(current, next)) {
+                return false;
+            }
+            if (!this->visited[next]) {
+                this->visited[next] = true;
+                if (!visitor.tree_edge(current, next) || !visitor.discover_vertex(next)) {
+                    return false;
+                }
+                this->frames.push_back(DFS_Frame(graph, next));
+            }
+        }
+        
+        return true;
+    }
+    
+private:
+    // scratch buffers
+    vector<bool> visited;
+    vector<int> queue;
+    vector<DFS_Frame> frames;
+    
+    void reset(const Graph& graph) {
+        this->visited.assign(graph.get_num_vertices(), false);
+        this->queue.clear();
+        this->frames.clear();
+    }
+};
+
+// Records BFS tree parents and stops once the target is discovered
+struct Path_Visitor : Default_Visitor {
+    Path_Visitor(vector<int>& parents, int target)
+    : parents(parents), target(target) {}
+    
+    bool tree_edge(int from, int to) {
+        this->parents[to] = from;
+        return true;
+    }
+    
+    bool discover_vertex(int vertex) {
+        return vertex != this->target;
+    }
+    
+    vector<int>& parents;
+    int target;
+};
+
 // BFS, DFS searches
 class Search {
 public:
@@ -648,10 +1172,8 @@ public:
         this->reset(graph);
         
         if (this->mode == DFS) {
-            vector<bool> visit_history(graph.get_num_vertices());
-
-            return this->has_cycle_dfs(graph, visit_history);
-            
+            DFS_Iterative dfs;
+            return dfs.has_cycle(graph);
         } else if (this->mode == BFS) {
             return this->has_cycle_bfs(graph);
         }
@@ -660,6 +1182,38 @@ public:
         
     }
     
+    // fewest-hop path between two vertices written into path,
+    // which keeps its capacity across calls
+    // return false if to cannot be reached
+    bool find_path(const Graph& graph, int from, int to, vector<int>& path) {
+        path.clear();
+        this->parents.assign(graph.get_num_vertices(), -1);
+        
+        Path_Visitor visitor(this->parents, to);
+        if (this->traversal.bfs(graph, from, visitor)) {
+            // ran to completion, target never discovered
+            return false;
+        }
+        
+        // walk back from target, then flip
+        for (int current = to; current != from; current = this->parents[current]) {
+            path.push_back(current);
+        }
+        path.push_back(from);
+        reverse(path.begin(), path.end());
+        return true;
+    }
+    
+    // whether in_graph records the visited vertices, on by default
+    void set_record_path(bool record_path) {
+        this->record_path = record_path;
+    }
+    
+    // path generated by the search
+    const vector<int>& get_path() const {
+        return this->path;
+    }
+    
     // print path generated by the search
     void print_path() const {
         
@@ -672,6 +1226,11 @@ public:
 private:
     // mode for search
     Mode mode;
+    // record visited vertices into path
+    bool record_path = true;
+    // BFS tree parents and traversal scratch for find_path
+    vector<int> parents;
+    Traversal traversal;
     // visited vector
     vector<bool> visited;
     // path visited
@@ -685,28 +1244,42 @@ private:
     }
     
     // in_graph utilities
-    bool in_graph_dfs(const Graph& graph, int vertex, int current = 0) {
-        
-        // add to path
-        this->path.push_back(current);
+    bool in_graph_dfs(const Graph& graph, int vertex) {
         
-        // visit current item
-        this->visited[current] = true;
-        if (current == vertex) {
+        // visit 0th item
+        if (this->record_path) {
+            this->path.push_back(0);
+        }
+        this->visited[0] = true;
+        if (vertex == 0) {
             return true;
         }
         
-        // visit adjacent vertices
-        auto it = graph.adj_begin(current);
-        auto it_end = graph.adj_end(current);
+        // explicit stack, so long paths cannot overflow the call stack
+        vector<DFS_Frame> frames;
+        frames.push_back(DFS_Frame(graph, 0));
         
-        while (it != it_end) {
-            if (!this->visited[*it]) {
-                this->visited[*it] = true;
-                bool found = this->in_graph_dfs(graph, vertex, *it);
-                if (found) return true;
+        while (!frames.empty()) {
+            DFS_Frame& frame = frames.back();
+            if (frame.it == frame.it_end) {
+                frames.pop_back();
+                continue;
+            }
+            int next = *frame.it;
+            ++ frame.it;
+            
+            // visit adjacent vertex
+            if (!this->visited[next]) {
+                this->visited[next] = true;
+                // add to path
+                if (this->record_path) {
+                    this->path.push_back(next);
+                }
+                if (next == vertex) {
+                    return true;
+                }
+                frames.push_back(DFS_Frame(graph, next));
             }
-            ++ it;
         }
         
         return false;
@@ -726,7 +1299,9 @@ private:
             this->visited[current] = true;
             
             // add to path
-            this->path.push_back(current);
+            if (this->record_path) {
+                this->path.push_back(current);
+            }
             
             if (current == vertex) {
                 return true;
@@ -751,71 +1326,89 @@ private:
     }
     
     // cyclic detection utilities
-    bool has_cycle_dfs(const Graph& graph, vector<bool>& history, int current = 0) {
-        
-        // visit current vertex
-        this->visited[current] = true;
-        history[current] = true;
-        
-        // dfs into adjacent vertices
-        auto it = graph.adj_begin(current);
-        auto it_end = graph.adj_end(current);
-        while (it != it_end) {
-            // if not visited, recurse in
-            if (!this->visited[*it]) {
-                // propagate up has a cycle detected
-                if(this->has_cycle_dfs(graph, history, *it)) {
-                    return true;
+    bool has_cycle_bfs(const Graph& graph) {
+        
+        // directed graphs, peel off vertices without incoming edges
+        // (Kahn's algorithm), whatever remains sits on a cycle
+        if (graph.get_directed()) {
+            vector<int> in_degrees(graph.get_num_vertices(), 0);
+            for (int v = 0; v < graph.get_num_vertices(); ++ v) {
+                auto it = graph.adj_begin(v);
+                auto it_end = graph.adj_end(v);
+                while (it != it_end) {
+                    ++ in_degrees[*it];
+                    ++ it;
+                }
+            }
+            
+            queue<int> q;
+            for (int v = 0; v < graph.get_num_vertices(); ++ v) {
+                if (in_degrees[v] == 0) {
+                    q.push(v);
+                }
+            }
+            
+            int num_peeled = 0;
+            while (!q.empty()) {
+                int current = q.front();
+                q.pop();
+                ++ num_peeled;
+                
+                auto it = graph.adj_begin(current);
+                auto it_end = graph.adj_end(current);
+                while (it != it_end) {
+                    if (-- in_degrees[*it] == 0) {
+                        q.push(*it);
+                    }
+                    ++ it;
                 }
-            } // if somewhere in history this vertex is visited
-            // meanng a cycle is detected
-            else if (history[*it]) {
-                return true;
             }
             
-            ++ it;
+            return num_peeled != graph.get_num_vertices();
         }
         
-        // undo the visit, simulating stack popped off
-        history[current] = false;
-        return false;
-    }
-    
-    bool has_cycle_bfs(const Graph& graph) {
-        
-        // make sure graph is not directed,
-        // if so, traditional BFS cost a fortune,
-        // and mechanism such as topological sort
-        // has to be used
-        assert(!graph.get_directed());
-        
-        // visit 0th item
-        queue<int> q;
-        q.push(0);
+        // undirected graphs, remember which vertex discovered each one
+        // so the edge back to it is not mistaken for a cycle
+        vector<int> parents(graph.get_num_vertices(), -1);
+        vector<bool> parent_skipped(graph.get_num_vertices(), false);
         
-        while (!q.empty()) {
-            
-            int current = q.front();
-            q.pop();
-            
-            this->visited[current] = true;
+        for (int source = 0; source < graph.get_num_vertices(); ++ source) {
+            if (this->visited[source]) {
+                continue;
+            }
             
-            auto it = graph.adj_begin(current);
-            auto it_end = graph.adj_end(current);
+            // visit source
+            queue<int> q;
+            q.push(source);
+            this->visited[source] = true;
             
-            while (it != it_end) {
+            while (!q.empty()) {
                 
-                // if ever encountering a visited
-                if (this->visited[*it]) {
-                    return true;
-                }
+                int current = q.front();
+                q.pop();
                 
-                this->visited[*it] = true;
-                q.push(*it);
+                auto it = graph.adj_begin(current);
+                auto it_end = graph.adj_end(current);
+                
+                while (it != it_end) {
+                    
+                    int next = *it;
+                    if (next == parents[current] && !parent_skipped[current]) {
+                        parent_skipped[current] = true;
+                    }
+                    // if ever encountering a visited
+                    else if (this->visited[next]) {
+                        return true;
+                    } else {
+                        this->visited[next] = true;
+                        parents[next] = current;
+                        q.push(next);
+                    }
+                    
+                    ++ it;
+                }
                 
-                ++ it;
             }
-            
         }
         
         return false;
@@ -823,24 +1416,1354 @@ private:
     
 };
 
-
-// tests
-void test_graph();
-void test_MST();
-void test_dijkstra();
-void test_search();
-
-// test the graph algorithms
-int main() {
+// Compressed sparse row snapshot of a graph,
+// so sweeps over neighbours walk one contiguous array
+class Compact_Graph {
+public:
     
-    test_graph();
-    test_MST();
-    test_dijkstra();
-    test_search();
+    // snapshot the adjacency of a graph
+    // reverse = true stores incoming edges instead of outgoing ones
+    void build(const Graph& graph, bool reverse = false) {
+        this->num_vertices = graph.get_num_vertices();
+        this->offsets.assign(this->num_vertices + 1, 0);
+        
+        // count degrees first
+        for (int v = 0; v < this->num_vertices; ++ v) {
+            auto it = graph.adj_begin(v);
+            auto it_end = graph.adj_end(v);
+            while (it != it_end) {
+                ++ this->offsets[(reverse ? *it : v) + 1];
+                ++ it;
+            }
+        }
+        // prefix sum into offsets
+        for (int v = 0; v < this->num_vertices; ++ v) {
+            this->offsets[v + 1] += this->offsets[v];
+        }
+        
+        // then scatter the targets
+        this->targets.resize(this->offsets[this->num_vertices]);
+        vector<size_t> cursor(this->offsets.begin(), this->offsets.end() - 1);
+        for (int v = 0; v < this->num_vertices; ++ v) {
+            auto it = graph.adj_begin(v);
+            auto it_end = graph.adj_end(v);
+            while (it != it_end) {
+                if (reverse) {
+                    this->targets[cursor[*it] ++] = v;
+                } else {
+                    this->targets[cursor[v] ++] = *it;
+                }
+                ++ it;
+            }
+        }
+    }
     
-    return 0;
-}
-
+    // get num vertices
+    int get_num_vertices() const {
+        return this->num_vertices;
+    }
+    
+    // get num of stored (directed) edges
+    size_t get_num_edges() const {
+        return this->targets.size();
+    }
+    
+    size_t degree(int vertex) const {
+        return this->offsets[vertex + 1] - this->offsets[vertex];
+    }
+    
+    // walk through adj vertices
+    const int* adj_begin(int vertex) const {
+        return this->targets.data() + this->offsets[vertex];
+    }
+    
+    const int* adj_end(int vertex) const {
+        return this->targets.data() + this->offsets[vertex + 1];
+    }
+    
+private:
+    // num vertices
+    int num_vertices = 0;
+    // vertex v owns targets[offsets[v], offsets[v + 1])
+    vector<size_t> offsets;
+    vector<int> targets;
+};
+
+// Dense bit set, one bit per vertex
+class Bitmap {
+public:
+    
+    // resize and clear all bits
+    void resize(size_t num_bits) {
+        this->words.assign((num_bits + 63) / 64, 0);
+    }
+    
+    void reset() {
+        fill(this->words.begin(), this->words.end(), 0);
+    }
+    
+    bool get(size_t pos) const {
+        return (this->words[pos >> 6] >> (pos & 63)) & 1;
+    }
+    
+    void set(size_t pos) {
+        this->words[pos >> 6] |= uint64_t(1) << (pos & 63);
+    }
+    
+    void swap(Bitmap& rhs) {
+        this->words.swap(rhs.words);
+    }
+    
+private:
+    vector<uint64_t> words;
+};
+
+// Direction-optimizing BFS (Beamer et al.)
+// switches between top-down steps over a sparse queue and
+// bottom-up steps over a bitmap frontier depending on frontier size
+class BFS_Direction_Optimizing {
+public:
+    
+    // switch to bottom-up once frontier edges exceed unexplored edges / alpha
+    void set_alpha(int alpha) {
+        this->alpha = alpha;
+    }
+    
+    // switch back to top-down once frontier shrinks below V / beta
+    void set_beta(int beta) {
+        this->beta = beta;
+    }
+    
+    // snapshot the graph, REQUIRED before search
+    void load(const Graph& graph) {
+        this->is_directed = graph.get_directed();
+        this->out_edges.build(graph);
+        // undirected graphs are symmetric, incoming == outgoing
+        if (this->is_directed) {
+            this->in_edges.build(graph, true);
+        }
+        this->revision = graph.get_revision();
+    }
+    
+    // run BFS from source, stop early once target gets a level
+    // a target of -1 explores everything reachable
+    void search(int source, int target = -1) {
+        this->reset();
+        
+        int num_vertices = this->out_edges.get_num_vertices();
+        
+        // visit source
+        vector<int> queue(1, source);
+        this->levels[source] = 0;
+        this->parents[source] = source;
+        this->visited.set(source);
+        
+        // edges left unexplored and edges leaving the frontier
+        long long edges_to_check = this->out_edges.get_num_edges();
+        long long scout_count = this->out_edges.degree(source);
+        int level = 0;
+        
+        while (!queue.empty() && (target == -1 || this->levels[target] == -1)) {
+            
+            if (scout_count > edges_to_check / this->alpha) {
+                // frontier is heavy, go bottom-up until it becomes small again
+                this->front.reset();
+                for (int v : queue) {
+                    this->front.set(v);
+                }
+                long long awake = queue.size();
+                long long old_awake;
+                do {
+                    old_awake = awake;
+                    awake = this->bottom_up_step(level ++);
+                    this->front.swap(this->next);
+                    ++ this->num_bottom_up_steps;
+                } while ((awake >= old_awake || awake > num_vertices / this->beta) &&
+                         awake != 0 &&
+                         (target == -1 || this->levels[target] == -1));
+                
+                // back to a sparse queue
+                queue.clear();
+                for (int v = 0; v < num_vertices; ++ v) {
+                    if (this->levels[v] == level) {
+                        queue.push_back(v);
+                    }
+                }
+                scout_count = 1;
+            } else {
+                edges_to_check -= scout_count;
+                scout_count = this->top_down_step(queue, level ++);
+            }
+        }
+    }
+    
+    // check whether vertex is reachable from vertex 0
+    // the snapshot is only rebuilt once the graph changed
+    bool in_graph(const Graph& graph, int vertex) {
+        if (graph.get_revision() != this->revision) {
+            this->load(graph);
+        }
+        this->search(0, vertex);
+        return this->levels[vertex] != -1;
+    }
+    
+    // hops from source, -1 if unreachable
+    const vector<int>& get_levels() const {
+        return this->levels;
+    }
+    
+    // BFS tree parent, source is its own parent, -1 if unreachable
+    const vector<int>& get_parents() const {
+        return this->parents;
+    }
+    
+    // number of bottom-up steps taken by the last search
+    int get_num_bottom_up_steps() const {
+        return this->num_bottom_up_steps;
+    }
+    
+private:
+    // heuristic parameters, defaults from the paper
+    int alpha = 15;
+    int beta = 18;
+    // graph snapshot and the revision it was taken at
+    bool is_directed = false;
+    Compact_Graph out_edges;
+    Compact_Graph in_edges;
+    uint64_t revision = 0;
+    // bfs states
+    vector<int> levels;
+    vector<int> parents;
+    Bitmap visited;
+    Bitmap front;
+    Bitmap next;
+    int num_bottom_up_steps = 0;
+    
+    // reset states for a new search
+    void reset() {
+        size_t size = this->out_edges.get_num_vertices();
+        this->levels.assign(size, -1);
+        this->parents.assign(size, -1);
+        this->visited.resize(size);
+        this->front.resize(size);
+        this->next.resize(size);
+        this->num_bottom_up_steps = 0;
+    }
+    
+    // expand every frontier vertex to its unvisited neighbours
+    // return num of edges leaving the new frontier
+    long long top_down_step(vector<int>& queue, int level) {
+        long long scout_count = 0;
+        vector<int> next_queue;
+        for (int current : queue) {
+            for (const int* it = this->out_edges.adj_begin(current);
+                 it != this->out_edges.adj_end(current); ++ it) {
+                int next = *it;
+                if (!this->visited.get(next)) {
+                    this->visited.set(next);
+                    this->levels[next] = level + 1;
+                    this->parents[next] = current;
+                    next_queue.push_back(next);
+                    scout_count += this->out_edges.degree(next);
+                }
+            }
+        }
+        queue.swap(next_queue);
+        return scout_count;
+    }
+    
+    // let every unvisited vertex look for a parent in the frontier
+    // return num of vertices woken up
+    long long bottom_up_step(int level) {
+        const Compact_Graph& incoming = this->is_directed ? this->in_edges : this->out_edges;
+        long long awake = 0;
+        this->next.reset();
+        for (int v = 0; v < incoming.get_num_vertices(); ++ v) {
+            if (this->visited.get(v)) {
+                continue;
+            }
+            for (const int* it = incoming.adj_begin(v); it != incoming.adj_end(v); ++ it) {
+                // first parent found is enough, skip remaining edges
+                if (this->front.get(*it)) {
+                    this->visited.set(v);
+                    this->levels[v] = level + 1;
+                    this->parents[v] = *it;
+                    this->next.set(v);
+                    ++ awake;
+                    break;
+                }
+            }
+        }
+        return awake;
+    }
+};
+
+// Bit-parallel multi-source BFS (Then et al.),
+// runs up to 64 * Words sources at once with one bit per source,
+// so every edge scan is shared by the whole batch
+template <size_t Words = 1>
+class BFS_Multi_Source {
+public:
+    // sources per batch
+    static const size_t MAX_SOURCES = 64 * Words;
+    
+    // snapshot the graph, REQUIRED before queries
+    void load(const Graph& graph) {
+        this->out_edges.build(graph);
+    }
+    
+    // hop distance for every <from, to> query, -1 if unreachable
+    vector<int> hop_distances(const vector<pair<int, int>>& queries) {
+        vector<int> result(queries.size(), -1);
+        
+        size_t begin = 0;
+        while (begin < queries.size()) {
+            // take queries until the batch runs out of source slots
+            this->slots.assign(this->out_edges.get_num_vertices(), -1);
+            this->sources.clear();
+            size_t end = begin;
+            for (; end < queries.size(); ++ end) {
+                int from = queries[end].first;
+                if (this->slots[from] == -1) {
+                    if (this->sources.size() == MAX_SOURCES) {
+                        break;
+                    }
+                    this->slots[from] = static_cast<int>(this->sources.size());
+                    this->sources.push_back(from);
+                }
+            }
+            this->run_batch(queries, begin, end, result);
+            begin = end;
+        }
+        
+        return result;
+    }
+    
+    // batched in_graph, whether from can reach to for every query
+    vector<bool> reachable(const vector<pair<int, int>>& queries) {
+        vector<int> distances = this->hop_distances(queries);
+        vector<bool> result(queries.size());
+        for (size_t i = 0; i < queries.size(); ++ i) {
+            result[i] = distances[i] != -1;
+        }
+        return result;
+    }
+    
+private:
+    // one bit per source of the batch
+    struct Lanes {
+        uint64_t words[Words];
+        
+        bool any() const {
+            uint64_t acc = 0;
+            for (size_t i = 0; i < Words; ++ i) {
+                acc |= this->words[i];
+            }
+            return acc != 0;
+        }
+        
+        bool test(int slot) const {
+            return (this->words[slot >> 6] >> (slot & 63)) & 1;
+        }
+        
+        void set(int slot) {
+            this->words[slot >> 6] |= uint64_t(1) << (slot & 63);
+        }
+    };
+    
+    // graph snapshot
+    Compact_Graph out_edges;
+    // batch slot per source vertex, -1 if not a source
+    vector<int> slots;
+    vector<int> sources;
+    // BFS states, one lane set per vertex
+    vector<Lanes> seen;
+    vector<Lanes> visit;
+    vector<Lanes> visit_next;
+    // unanswered queries by target vertex, as linked lists
+    vector<int> query_heads;
+    vector<int> query_nexts;
+    
+    void run_batch(const vector<pair<int, int>>& queries,
+                   size_t begin, size_t end, vector<int>& result) {
+        int num_vertices = this->out_edges.get_num_vertices();
+        Lanes empty;
+        fill(empty.words, empty.words + Words, 0);
+        this->seen.assign(num_vertices, empty);
+        this->visit.assign(num_vertices, empty);
+        this->visit_next.assign(num_vertices, empty);
+        this->query_heads.assign(num_vertices, -1);
+        this->query_nexts.assign(end - begin, -1);
+        
+        // visit every source in its own lane
+        for (size_t slot = 0; slot < this->sources.size(); ++ slot) {
+            this->seen[this->sources[slot]].set(static_cast<int>(slot));
+            this->visit[this->sources[slot]].set(static_cast<int>(slot));
+        }
+        
+        // file queries under their target
+        size_t num_pending = 0;
+        for (size_t i = begin; i < end; ++ i) {
+            if (queries[i].first == queries[i].second) {
+                result[i] = 0;
+                continue;
+            }
+            int to = queries[i].second;
+            this->query_nexts[i - begin] = this->query_heads[to];
+            this->query_heads[to] = static_cast<int>(i - begin);
+            ++ num_pending;
+        }
+        
+        int level = 0;
+        bool active = true;
+        while (active && num_pending > 0) {
+            
+            // push every lane of a frontier vertex to its neighbours
+            for (int v = 0; v < num_vertices; ++ v) {
+                const Lanes& lanes = this->visit[v];
+                if (!lanes.any()) {
+                    continue;
+                }
+                for (const int* it = this->out_edges.adj_begin(v); it != this->out_edges.adj_end(v); ++ it) {
+                    Lanes& target = this->visit_next[*it];
+                    for (size_t w = 0; w < Words; ++ w) {
+                        target.words[w] |= lanes.words[w];
+                    }
+                }
+            }
+            
+            // keep only lanes seeing a vertex for the first time
+            ++ level;
+            active = false;
+            for (int v = 0; v < num_vertices; ++ v) {
+                Lanes& next = this->visit_next[v];
+                for (size_t w = 0; w < Words; ++ w) {
+                    next.words[w] &= ~this->seen[v].words[w];
+                    this->seen[v].words[w] |= next.words[w];
+                }
+                if (!next.any()) {
+                    continue;
+                }
+                active = true;
+                
+                // answer queries whose source just arrived
+                int* link = &this->query_heads[v];
+                while (*link != -1) {
+                    int q = *link;
+                    if (next.test(this->slots[queries[begin + q].first])) {
+                        result[begin + q] = level;
+                        -- num_pending;
+                        *link = this->query_nexts[q];
+                    } else {
+                        link = &this->query_nexts[q];
+                    }
+                }
+            }
+            
+            this->visit.swap(this->visit_next);
+            fill(this->visit_next.begin(), this->visit_next.end(), empty);
+        }
+    }
+};
+
+// Fixed-size thread pool, each worker owns a deque of chunks
+// and steals from the others once its own runs dry
+class Work_Stealing_Pool {
+public:
+    
+    // the calling thread acts as worker 0
+    explicit Work_Stealing_Pool(unsigned num_threads = thread::hardware_concurrency()) {
+        this->num_threads = max(1u, num_threads);
+        for (unsigned i = 0; i < this->num_threads; ++ i) {
+            this->queues.emplace_back(new Worker_Queue());
+        }
+        for (unsigned i = 1; i < this->num_threads; ++ i) {
+            this->threads.emplace_back(&Work_Stealing_Pool::worker_loop, this, i);
+        }
+    }
+    
+    // no copy
+    Work_Stealing_Pool(const Work_Stealing_Pool&) = delete;
+    Work_Stealing_Pool& operator=(const Work_Stealing_Pool&) = delete;
+    
+    ~Work_Stealing_Pool() {
+        {
+            lock_guard<mutex> lock(this->state_lock);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        for (auto& t : this->threads) {
+            t.join();
+        }
+    }
+    
+    unsigned get_num_threads() const {
+        return this->num_threads;
+    }
+    
+    // run fn(worker, lo, hi) over [begin, end) in chunks of grain,
+    // block until every chunk is done
+    void parallel_for(size_t begin, size_t end, size_t grain,
+                      const function<void(unsigned, size_t, size_t)>& fn) {
+        if (begin >= end) {
+            return;
+        }
+        grain = max<size_t>(1, grain);
+        size_t num_chunks = (end - begin + grain - 1) / grain;
+        // not worth waking anyone up
+        if (this->num_threads == 1 || num_chunks == 1) {
+            fn(0, begin, end);
+            return;
+        }
+        
+        // publish the job before any chunk becomes visible
+        {
+            lock_guard<mutex> lock(this->state_lock);
+            this->job = &fn;
+        }
+        this->pending = num_chunks;
+        // deal chunks round robin
+        for (size_t i = 0; i < num_chunks; ++ i) {
+            size_t lo = begin + i * grain;
+            Worker_Queue& q = *this->queues[i % this->num_threads];
+            lock_guard<mutex> lock(q.lock);
+            q.chunks.push_back(make_pair(lo, min(end, lo + grain)));
+        }
+        {
+            lock_guard<mutex> lock(this->state_lock);
+            ++ this->generation;
+        }
+        this->wake.notify_all();
+        
+        // help out, then wait for chunks still running elsewhere
+        this->work(0);
+        unique_lock<mutex> lock(this->state_lock);
+        this->done.wait(lock, [this]() { return this->pending == 0; });
+        this->job = nullptr;
+    }
+    
+private:
+    // per worker chunk deque
+    struct Worker_Queue {
+        mutex lock;
+        deque<pair<size_t, size_t>> chunks;
+    };
+    
+    unsigned num_threads;
+    vector<unique_ptr<Worker_Queue>> queues;
+    vector<thread> threads;
+    // job states
+    mutex state_lock;
+    condition_variable wake;
+    condition_variable done;
+    size_t generation = 0;
+    bool stopping = false;
+    const function<void(unsigned, size_t, size_t)>* job = nullptr;
+    atomic<size_t> pending{0};
+    
+    void worker_loop(unsigned id) {
+        size_t seen = 0;
+        while (true) {
+            {
+                unique_lock<mutex> lock(this->state_lock);
+                this->wake.wait(lock, [&]() { return this->stopping || this->generation != seen; });
+                if (this->stopping) {
+                    return;
+                }
+                seen = this->generation;
+            }
+            this->work(id);
+        }
+    }
+    
+    // drain own deque from the back, then steal from others' front
+    void work(unsigned id) {
+        pair<size_t, size_t> chunk;
+        while (this->pending > 0 && (this->pop(id, chunk) || this->steal(id, chunk))) {
+            (*this->job)(id, chunk.first, chunk.second);
+            if (-- this->pending == 0) {
+                lock_guard<mutex> lock(this->state_lock);
+                this->done.notify_all();
+            }
+        }
+    }
+    
+    bool pop(unsigned id, pair<size_t, size_t>& chunk) {
+        Worker_Queue& q = *this->queues[id];
+        lock_guard<mutex> lock(q.lock);
+        if (q.chunks.empty()) {
+            return false;
+        }
+        chunk = q.chunks.back();
+        q.chunks.pop_back();
+        return true;
+    }
+    
+    bool steal(unsigned id, pair<size_t, size_t>& chunk) {
+        for (unsigned i = 1; i < this->num_threads; ++ i) {
+            Worker_Queue& q = *this->queues[(id + i) % this->num_threads];
+            lock_guard<mutex> lock(q.lock);
+            if (!q.chunks.empty()) {
+                chunk = q.chunks.front();
+                q.chunks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Level-synchronous BFS, each frontier level is split across a pool,
+// vertices are claimed with atomics and every worker
+// fills its own next-frontier buffer
+class BFS_Parallel {
+public:
+    
+    explicit BFS_Parallel(unsigned num_threads = thread::hardware_concurrency())
+    : pool(num_threads) {}
+    
+    // frontier vertices per stealable chunk
+    void set_grain(size_t grain) {
+        this->grain = max<size_t>(1, grain);
+    }
+    
+    // run BFS from source, stop after the level that reaches target
+    // a target of -1 explores everything reachable
+    void search(const Graph& graph, int source, int target = -1) {
+        this->reset(graph);
+        
+        // visit source
+        vector<int> frontier(1, source);
+        this->levels[source] = 0;
+        int level = 0;
+        
+        while (!frontier.empty() && (target == -1 || this->levels[target] == -1)) {
+            
+            // expand the frontier, each worker keeps its own discoveries
+            this->pool.parallel_for(0, frontier.size(), this->grain,
+                                    [&](unsigned worker, size_t lo, size_t hi) {
+                vector<int>& local = this->buffers[worker];
+                for (size_t i = lo; i < hi; ++ i) {
+                    auto it = graph.adj_begin(frontier[i]);
+                    auto it_end = graph.adj_end(frontier[i]);
+                    while (it != it_end) {
+                        int next = *it;
+                        int unvisited = -1;
+                        // claim once, whoever wins the swap owns the vertex
+                        if (this->levels[next].load(memory_order_relaxed) == -1 &&
+                            this->levels[next].compare_exchange_strong(unvisited, level + 1)) {
+                            local.push_back(next);
+                        }
+                        ++ it;
+                    }
+                }
+            });
+            
+            // concat local buffers into the next frontier
+            frontier.clear();
+            for (auto& local : this->buffers) {
+                frontier.insert(frontier.end(), local.begin(), local.end());
+                local.clear();
+            }
+            ++ level;
+        }
+    }
+    
+    // check whether vertex is reachable from vertex 0
+    bool in_graph(const Graph& graph, int vertex) {
+        this->search(graph, 0, vertex);
+        return this->levels[vertex] != -1;
+    }
+    
+    // hops from source, -1 if unreachable
+    int get_level(int vertex) const {
+        return this->levels[vertex];
+    }
+    
+    vector<int> get_levels() const {
+        vector<int> result(this->num_vertices);
+        for (int v = 0; v < this->num_vertices; ++ v) {
+            result[v] = this->levels[v];
+        }
+        return result;
+    }
+    
+private:
+    Work_Stealing_Pool pool;
+    size_t grain = 64;
+    int num_vertices = 0;
+    // level per vertex, doubles as the visited flag
+    unique_ptr<atomic<int>[]> levels;
+    // next-frontier buffer per worker
+    vector<vector<int>> buffers;
+    
+    // reset states for a new search
+    void reset(const Graph& graph) {
+        if (graph.get_num_vertices() != this->num_vertices || !this->levels) {
+            this->num_vertices = graph.get_num_vertices();
+            this->levels.reset(new atomic<int>[this->num_vertices]);
+        }
+        for (int v = 0; v < this->num_vertices; ++ v) {
+            this->levels[v].store(-1, memory_order_relaxed);
+        }
+        this->buffers.resize(this->pool.get_num_threads());
+    }
+};
+
+// Kahn's topological sort, each wave of zero in-degree vertices
+// is processed in parallel and in-degrees are decremented atomically
+class Topological_Kahn_Parallel {
+public:
+    
+    explicit Topological_Kahn_Parallel(unsigned num_threads = thread::hardware_concurrency())
+    : pool(num_threads) {}
+    
+    // vertices per stealable chunk
+    void set_grain(size_t grain) {
+        this->grain = max<size_t>(1, grain);
+    }
+    
+    // return false if the graph has a cycle
+    bool sort(const Graph& graph) {
+        
+        // only meaningful for directed graphs
+        assert(graph.get_directed());
+        
+        int num_vertices = graph.get_num_vertices();
+        this->in_degrees.reset(new atomic<int>[num_vertices]);
+        this->buffers.assign(this->pool.get_num_threads(), vector<int>());
+        this->order.clear();
+        this->order.reserve(num_vertices);
+        
+        for (int v = 0; v < num_vertices; ++ v) {
+            this->in_degrees[v].store(0, memory_order_relaxed);
+        }
+        // count in-degrees
+        this->pool.parallel_for(0, num_vertices, this->grain,
+                                [&](unsigned, size_t lo, size_t hi) {
+            for (size_t v = lo; v < hi; ++ v) {
+                auto it = graph.adj_begin(static_cast<int>(v));
+                auto it_end = graph.adj_end(static_cast<int>(v));
+                while (it != it_end) {
+                    this->in_degrees[*it].fetch_add(1, memory_order_relaxed);
+                    ++ it;
+                }
+            }
+        });
+        
+        // first wave, vertices without incoming edges
+        for (int v = 0; v < num_vertices; ++ v) {
+            if (this->in_degrees[v].load(memory_order_relaxed) == 0) {
+                this->order.push_back(v);
+            }
+        }
+        
+        // the order vector doubles as the queue, [begin, end) is the current wave
+        size_t begin = 0;
+        while (begin < this->order.size()) {
+            size_t end = this->order.size();
+            
+            this->pool.parallel_for(begin, end, this->grain,
+                                    [&](unsigned worker, size_t lo, size_t hi) {
+                vector<int>& local = this->buffers[worker];
+                for (size_t i = lo; i < hi; ++ i) {
+                    auto it = graph.adj_begin(this->order[i]);
+                    auto it_end = graph.adj_end(this->order[i]);
+                    while (it != it_end) {
+                        // the last incoming edge releases the vertex
+                        if (this->in_degrees[*it].fetch_sub(1, memory_order_acq_rel) == 1) {
+                            local.push_back(*it);
+                        }
+                        ++ it;
+                    }
+                }
+            });
+            
+            // next wave
+            for (auto& local : this->buffers) {
+                this->order.insert(this->order.end(), local.begin(), local.end());
+                local.clear();
+            }
+            begin = end;
+        }
+        
+        // anything left never lost its incoming edges, sits on a cycle
+        return this->order.size() == static_cast<size_t>(num_vertices);
+    }
+    
+    // vertices in topological order, partial if a cycle was found
+    const vector<int>& get_order() const {
+        return this->order;
+    }
+    
+private:
+    Work_Stealing_Pool pool;
+    size_t grain = 256;
+    unique_ptr<atomic<int>[]> in_degrees;
+    // released vertices per worker
+    vector<vector<int>> buffers;
+    vector<int> order;
+};
+
+// Parallel connected components through Afforest (Sutton et al.).
+// Link a few neighbours of every vertex, guess the giant component
+// from a sample and only link the remaining edges of everyone else.
+// Directed graphs get their weakly connected components
+class Connected_Components {
+public:
+    
+    explicit Connected_Components(unsigned num_threads = thread::hardware_concurrency())
+    : pool(num_threads) {}
+    
+    // neighbours linked per vertex before sampling
+    void set_neighbor_rounds(int neighbor_rounds) {
+        this->neighbor_rounds = max(0, neighbor_rounds);
+    }
+    
+    // vertices per stealable chunk
+    void set_grain(size_t grain) {
+        this->grain = max<size_t>(1, grain);
+    }
+    
+    // label every vertex, return num of components
+    int build(const Graph& graph) {
+        int num_vertices = graph.get_num_vertices();
+        this->out_edges.build(graph);
+        if (graph.get_directed()) {
+            this->in_edges.build(graph, true);
+        }
+        
+        this->parents.reset(new atomic<int>[num_vertices]);
+        this->pool.parallel_for(0, num_vertices, this->grain, [this](unsigned, size_t lo, size_t hi) {
+            for (size_t v = lo; v < hi; ++ v) {
+                this->parents[v].store(static_cast<int>(v), memory_order_relaxed);
+            }
+        });
+        
+        // link the first few neighbours of every vertex
+        for (int round = 0; round < this->neighbor_rounds; ++ round) {
+            this->pool.parallel_for(0, num_vertices, this->grain, [this, round](unsigned, size_t lo, size_t hi) {
+                for (size_t v = lo; v < hi; ++ v) {
+                    if (static_cast<size_t>(round) < this->out_edges.degree(static_cast<int>(v))) {
+                        this->link(static_cast<int>(v), this->out_edges.adj_begin(static_cast<int>(v))[round]);
+                    }
+                }
+            });
+            this->compress(num_vertices);
+        }
+        
+        // the giant component already has its spanning forest,
+        // finish linking every other vertex
+        int frequent = this->sample_frequent(num_vertices);
+        bool directed = graph.get_directed();
+        this->pool.parallel_for(0, num_vertices, this->grain, [&](unsigned, size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++ i) {
+                int v = static_cast<int>(i);
+                if (this->parents[v].load(memory_order_relaxed) == frequent) {
+                    continue;
+                }
+                const int* it = this->out_edges.adj_begin(v) +
+                                min<size_t>(this->neighbor_rounds, this->out_edges.degree(v));
+                for (; it != this->out_edges.adj_end(v); ++ it) {
+                    this->link(v, *it);
+                }
+                // skipped vertices only linked outgoing edges,
+                // incoming ones from them must be linked here
+                if (directed) {
+                    for (it = this->in_edges.adj_begin(v); it != this->in_edges.adj_end(v); ++ it) {
+                        this->link(v, *it);
+                    }
+                }
+            }
+        });
+        this->compress(num_vertices);
+        
+        // relabel roots into dense ids
+        this->components.assign(num_vertices, -1);
+        this->sizes.clear();
+        for (int v = 0; v < num_vertices; ++ v) {
+            int root = this->parents[v].load(memory_order_relaxed);
+            if (this->components[root] == -1) {
+                this->components[root] = static_cast<int>(this->sizes.size());
+                this->sizes.push_back(0);
+            }
+            this->components[v] = this->components[root];
+            ++ this->sizes[this->components[v]];
+        }
+        
+        return static_cast<int>(this->sizes.size());
+    }
+    
+    // component id per vertex, ids are 0 .. num of components - 1
+    const vector<int>& get_components() const {
+        return this->components;
+    }
+    
+    // num of vertices per component
+    const vector<int>& get_sizes() const {
+        return this->sizes;
+    }
+    
+private:
+    Work_Stealing_Pool pool;
+    int neighbor_rounds = 2;
+    size_t grain = 1024;
+    // graph snapshot
+    Compact_Graph out_edges;
+    Compact_Graph in_edges;
+    // union-find forest, roots always have the smallest id in their tree
+    unique_ptr<atomic<int>[]> parents;
+    // results
+    vector<int> components;
+    vector<int> sizes;
+    
+    // hook the higher root under the lower one, retry on races
+    void link(int u, int v) {
+        int p1 = this->parents[u].load(memory_order_relaxed);
+        int p2 = this->parents[v].load(memory_order_relaxed);
+        while (p1 != p2) {
+            int high = max(p1, p2);
+            int low = min(p1, p2);
+            int p_high = this->parents[high].load(memory_order_relaxed);
+            // already hooked
+            if (p_high == low) {
+                break;
+            }
+            if (p_high == high &&
+                this->parents[high].compare_exchange_strong(p_high, low)) {
+                break;
+            }
+            p1 = this->parents[this->parents[high].load(memory_order_relaxed)].load(memory_order_relaxed);
+            p2 = this->parents[low].load(memory_order_relaxed);
+        }
+    }
+    
+    // pointer jumping until every vertex points at its root
+    void compress(int num_vertices) {
+        this->pool.parallel_for(0, num_vertices, this->grain, [this](unsigned, size_t lo, size_t hi) {
+            for (size_t v = lo; v < hi; ++ v) {
+                int parent = this->parents[v].load(memory_order_relaxed);
+                int grand = this->parents[parent].load(memory_order_relaxed);
+                while (parent != grand) {
+                    this->parents[v].store(grand, memory_order_relaxed);
+                    parent = grand;
+                    grand = this->parents[parent].load(memory_order_relaxed);
+                }
+            }
+        });
+    }
+    
+    // most frequent root among a fixed sample of vertices
+    int sample_frequent(int num_vertices) {
+        if (num_vertices == 0) {
+            return -1;
+        }
+        const int num_samples = 1024;
+        vector<int> samples;
+        unsigned state = 27491095;
+        for (int i = 0; i < num_samples; ++ i) {
+            state = state * 1103515245 + 12345;
+            samples.push_back(this->parents[(state >> 8) % num_vertices].load(memory_order_relaxed));
+        }
+        sort(samples.begin(), samples.end());
+        
+        int best = samples[0];
+        int best_count = 0;
+        for (size_t i = 0; i < samples.size();) {
+            size_t j = i;
+            while (j < samples.size() && samples[j] == samples[i]) {
+                ++ j;
+            }
+            if (static_cast<int>(j - i) > best_count) {
+                best = samples[i];
+                best_count = static_cast<int>(j - i);
+            }
+            i = j;
+        }
+        return best;
+    }
+};
+
+// Reachability index answering "can u reach v" without a fresh traversal.
+// Directed graphs get condensed into a DAG of SCCs carrying GRAIL
+// interval labels, queries the labels cannot settle fall back to a
+// DFS pruned by the labels. Undirected graphs only need component ids.
+class Reachability_Index {
+public:
+    
+    // num of independent random interval labelings
+    explicit Reachability_Index(int num_labels = 3,
+                                unsigned num_threads = thread::hardware_concurrency())
+    : num_labels(max(1, num_labels)), num_threads(num_threads) {}
+    
+    // build the index for a graph
+    void build(const Graph& graph) {
+        this->is_directed = graph.get_directed();
+        this->dag_offsets.clear();
+        this->dag_targets.clear();
+        this->labels.clear();
+        
+        // undirected graphs only need connected components
+        if (!this->is_directed) {
+            Connected_Components cc(this->num_threads);
+            this->num_components = cc.build(graph);
+            this->components = cc.get_components();
+            return;
+        }
+        
+        // SCCs, ids in reverse topological order
+        DFS_Iterative dfs;
+        this->num_components = dfs.strongly_connected_components(graph);
+        this->components = dfs.get_components();
+        
+        this->build_dag(graph);
+        
+        // labelings are independent, build them in parallel
+        this->labels.assign(this->num_labels, vector<pair<int, int>>(this->num_components));
+        Work_Stealing_Pool pool(min<unsigned>(this->num_threads, this->num_labels));
+        pool.parallel_for(0, this->num_labels, 1, [this](unsigned, size_t lo, size_t hi) {
+            for (size_t i = lo; i < hi; ++ i) {
+                this->build_labels(static_cast<unsigned>(i), this->labels[i]);
+            }
+        });
+    }
+    
+    // check whether from can reach to, safe to call from many threads
+    bool reachable(int from, int to) const {
+        int source = this->components[from];
+        int target = this->components[to];
+        if (source == target) {
+            return true;
+        }
+        if (!this->is_directed) {
+            return false;
+        }
+        // SCC ids are in reverse topological order,
+        // edges only ever lead to smaller ids
+        if (source < target || !this->contains(source, target)) {
+            return false;
+        }
+        
+        // labels cannot tell, search the DAG skipping
+        // every component whose labels exclude the target
+        // visited stamps belong to the calling thread, a fresh stamp
+        // per search keeps older marks from counting
+        thread_local vector<unsigned> stamps;
+        thread_local unsigned stamp = 0;
+        if (++ stamp == 0) {
+            stamps.assign(stamps.size(), 0);
+            stamp = 1;
+        }
+        if (stamps.size() < static_cast<size_t>(this->num_components)) {
+            stamps.resize(this->num_components, 0);
+        }
+        vector<int> frames(1, source);
+        stamps[source] = stamp;
+        while (!frames.empty()) {
+            int current = frames.back();
+            frames.pop_back();
+            for (int i = this->dag_offsets[current]; i < this->dag_offsets[current + 1]; ++ i) {
+                int next = this->dag_targets[i];
+                if (next == target) {
+                    return true;
+                }
+                if (stamps[next] != stamp && next > target && this->contains(next, target)) {
+                    stamps[next] = stamp;
+                    frames.push_back(next);
+                }
+            }
+        }
+        
+        return false;
+    }
+    
+    // write the index in a binary format
+    void save(ostream& os) const {
+        os.write(MAGIC, 4);
+        this->write_value(os, static_cast<int>(this->is_directed));
+        this->write_value(os, this->num_components);
+        this->write_value(os, this->num_labels);
+        this->write_vector(os, this->components);
+        this->write_vector(os, this->dag_offsets);
+        this->write_vector(os, this->dag_targets);
+        for (auto& labeling : this->labels) {
+            this->write_vector(os, labeling);
+        }
+    }
+    
+    // read an index written by save
+    // return false if the stream does not hold one
+    bool load(istream& is) {
+        char magic[4];
+        if (!is.read(magic, 4) || !equal(magic, magic + 4, MAGIC)) {
+            return false;
+        }
+        int directed = 0;
+        this->read_value(is, directed);
+        this->is_directed = directed != 0;
+        this->read_value(is, this->num_components);
+        this->read_value(is, this->num_labels);
+        this->read_vector(is, this->components);
+        this->read_vector(is, this->dag_offsets);
+        this->read_vector(is, this->dag_targets);
+        this->labels.assign(this->is_directed ? this->num_labels : 0, vector<pair<int, int>>());
+        for (auto& labeling : this->labels) {
+            this->read_vector(is, labeling);
+        }
+        return static_cast<bool>(is);
+    }
+    
+private:
+    // file signature
+    static constexpr const char* MAGIC = "RIDX";
+    // settings
+    int num_labels;
+    unsigned num_threads;
+    // component per vertex
+    bool is_directed = false;
+    int num_components = 0;
+    vector<int> components;
+    // condensed DAG, component c points at dag_targets[dag_offsets[c], dag_offsets[c + 1])
+    vector<int> dag_offsets;
+    vector<int> dag_targets;
+    // <low, post order rank> interval per labeling per component
+    vector<vector<pair<int, int>>> labels;
+    
+    // whether every labeling allows source to reach target
+    bool contains(int source, int target) const {
+        for (auto& labeling : this->labels) {
+            if (labeling[target].first < labeling[source].first ||
+                labeling[target].second > labeling[source].second) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // condense SCCs into a DAG without duplicate edges
+    void build_dag(const Graph& graph) {
+        vector<vector<int>> adjacent(this->num_components);
+        for (int v = 0; v < graph.get_num_vertices(); ++ v) {
+            auto it = graph.adj_begin(v);
+            auto it_end = graph.adj_end(v);
+            while (it != it_end) {
+                if (this->components[v] != this->components[*it]) {
+                    adjacent[this->components[v]].push_back(this->components[*it]);
+                }
+                ++ it;
+            }
+        }
+        
+        this->dag_offsets.assign(1, 0);
+        for (auto& targets : adjacent) {
+            sort(targets.begin(), targets.end());
+            targets.erase(unique(targets.begin(), targets.end()), targets.end());
+            this->dag_targets.insert(this->dag_targets.end(), targets.begin(), targets.end());
+            this->dag_offsets.push_back(static_cast<int>(this->dag_targets.size()));
+        }
+    }
+    
+    // one GRAIL labeling, a DFS over the DAG in random child order
+    // rank is the post order number, low the smallest rank below
+    void build_labels(unsigned seed, vector<pair<int, int>>& labeling) const {
+        int n = this->num_components;
+        vector<int> children(this->dag_targets);
+        unsigned state = seed * 2654435761u + 1;
+        // shuffle every child list
+        for (int c = 0; c < n; ++ c) {
+            for (int i = this->dag_offsets[c + 1] - 1; i > this->dag_offsets[c]; -- i) {
+                state = state * 1103515245 + 12345;
+                int j = this->dag_offsets[c] + (state >> 8) % (i - this->dag_offsets[c] + 1);
+                swap(children[i], children[j]);
+            }
+        }
+        
+        // roots have no incoming edges
+        vector<bool> has_parent(n, false);
+        for (int c : this->dag_targets) {
+            has_parent[c] = true;
+        }
+        vector<int> roots;
+        for (int c = 0; c < n; ++ c) {
+            if (!has_parent[c]) {
+                roots.push_back(c);
+            }
+        }
+        for (int i = static_cast<int>(roots.size()) - 1; i > 0; -- i) {
+            state = state * 1103515245 + 12345;
+            swap(roots[i], roots[(state >> 8) % (i + 1)]);
+        }
+        
+        // explicit stack of <component, next child position>
+        vector<bool> visited(n, false);
+        vector<pair<int, int>> frames;
+        int rank = 0;
+        for (int root : roots) {
+            visited[root] = true;
+            frames.push_back(make_pair(root, this->dag_offsets[root]));
+            labeling[root].first = numeric_limits<int>::max();
+            
+            while (!frames.empty()) {
+                int current = frames.back().first;
+                int& pos = frames.back().second;
+                if (pos < this->dag_offsets[current + 1]) {
+                    int next = children[pos ++];
+                    if (!visited[next]) {
+                        visited[next] = true;
+                        labeling[next].first = numeric_limits<int>::max();
+                        frames.push_back(make_pair(next, this->dag_offsets[next]));
+                    } else {
+                        labeling[current].first = min(labeling[current].first, labeling[next].first);
+                    }
+                    continue;
+                }
+                // finished, fix rank and pass low up
+                labeling[current].second = ++ rank;
+                labeling[current].first = min(labeling[current].first, rank);
+                frames.pop_back();
+                if (!frames.empty()) {
+                    int parent = frames.back().first;
+                    labeling[parent].first = min(labeling[parent].first, labeling[current].first);
+                }
+            }
+        }
+    }
+    
+    // binary helpers
+    template <typename T>
+    static void write_value(ostream& os, const T& value) {
+        os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    
+    template <typename T>
+    static void read_value(istream& is, T& value) {
+        is.read(reinterpret_cast<char*>(&value), sizeof(T));
+    }
+    
+    template <typename T>
+    static void write_vector(ostream& os, const vector<T>& values) {
+        uint64_t size = values.size();
+        write_value(os, size);
+        os.write(reinterpret_cast<const char*>(values.data()), size * sizeof(T));
+    }
+    
+    template <typename T>
+    static void read_vector(istream& is, vector<T>& values) {
+        uint64_t size = 0;
+        read_value(is, size);
+        if (!is) {
+            return;
+        }
+        values.resize(size);
+        is.read(reinterpret_cast<char*>(values.data()), size * sizeof(T));
+    }
+};
+
+constexpr const char* Reachability_Index::MAGIC;
+
+// Graph shared by one writer and many readers.
+// Readers pin an immutable version for as long as a search runs,
+// the writer batches edge additions and publishes them as the next
+// version with a single atomic swap. A version is reclaimed once its
+// last reader drops the pin, RCU style through reference counts
+class Versioned_Graph {
+public:
+    
+    // graph must be configured, it becomes version 0
+    explicit Versioned_Graph(const Graph& graph)
+    : current(make_shared<const Version>(0, graph)) {}
+    
+    // pin the latest version, readers hold it for a whole run
+    shared_ptr<const Graph> pin() const {
+        shared_ptr<const Version> version = atomic_load(&this->current);
+        // aliasing ctor, shares ownership of the whole version
+        return shared_ptr<const Graph>(version, &version->graph);
+    }
+    
+    // version number of the latest published graph
+    size_t get_version() const {
+        return atomic_load(&this->current)->number;
+    }
+    
+    // queue an edge for the next version
+    void add_edge(int from, int to, int weight = 1) {
+        lock_guard<mutex> lock(this->writer_lock);
+        this->pending.push_back(vector<int>({from, to, weight}));
+    }
+    
+    // publish queued edges as a new version, return its number
+    // readers keep whatever version they already pinned
+    size_t commit() {
+        lock_guard<mutex> lock(this->writer_lock);
+        shared_ptr<const Version> latest = atomic_load(&this->current);
+        if (this->pending.empty()) {
+            return latest->number;
+        }
+        
+        // copy on write, nobody else can see the copy yet; it shares rows
+        // and edge chunks with latest, the batch clones the ones it touches,
+        // so a commit costs O(V + E / chunk size) plus the batch
+        shared_ptr<Version> next = make_shared<Version>(latest->number + 1, latest->graph);
+        for (auto& edge : this->pending) {
+            next->graph.add_edge(edge[0], edge[1], edge[2]);
+        }
+        this->pending.clear();
+        
+        atomic_store(&this->current, shared_ptr<const Version>(next));
+        return next->number;
+    }
+    
+private:
+    // a published graph and its number
+    struct Version {
+        Version(size_t number, const Graph& graph)
+        : number(number), graph(graph) {}
+        
+        size_t number;
+        Graph graph;
+    };
+    
+    // latest version, only touched through atomic_load/atomic_store
+    shared_ptr<const Version> current;
+    // writer side
+    mutex writer_lock;
+    vector<vector<int>> pending;
+};
+
+
+// tests
+void test_graph();
+void test_MST();
+void test_dijkstra();
+void test_search();
+void test_bfs_direction_optimizing();
+void test_bfs_parallel();
+void test_dfs_iterative();
+void test_bfs_multi_source();
+void test_reachability_index();
+void test_traversal();
+void test_connected_components();
+void test_versioned_graph();
+
+// test the graph algorithms
+int main() {
+    
+    test_graph();
+    test_MST();
+    test_dijkstra();
+    test_search();
+    test_bfs_direction_optimizing();
+    test_bfs_parallel();
+    test_dfs_iterative();
+    test_bfs_multi_source();
+    test_reachability_index();
+    test_traversal();
+    test_connected_components();
+    test_versioned_graph();
+    
+    return 0;
+}
+
 void test_graph() {
     
     // test adj list mode
@@ -1013,3 +2936,613 @@ void test_search() {
     
     cout << "Test search success!" << endl;
 }
+
+void test_bfs_direction_optimizing() {
+    
+    for (int directed = 0; directed <= 1; ++ directed) {
+        
+        // pseudo random low diameter graph
+        Graph g1;
+        g1.set_num_vertices(300);
+        g1.set_directed(directed);
+        g1.set_graph_representation(Graph::Mode::BOTH);
+        
+        unsigned seed = 42;
+        for (int i = 0; i < 1500; ++ i) {
+            seed = seed * 1103515245 + 12345;
+            int from = (seed >> 8) % 250;
+            seed = seed * 1103515245 + 12345;
+            int to = (seed >> 8) % 250;
+            g1.add_edge(from, to);
+        }
+        
+        // reference levels using plain BFS
+        vector<int> expected(g1.get_num_vertices(), -1);
+        queue<int> q;
+        q.push(0);
+        expected[0] = 0;
+        while (!q.empty()) {
+            int current = q.front();
+            q.pop();
+            auto it = g1.adj_begin(current);
+            auto it_end = g1.adj_end(current);
+            while (it != it_end) {
+                if (expected[*it] == -1) {
+                    expected[*it] = expected[current] + 1;
+                    q.push(*it);
+                }
+                ++ it;
+            }
+        }
+        
+        // try pure top-down, default and eager bottom-up
+        int alphas[] = { 1, 15, 1000000 };
+        for (int alpha : alphas) {
+            BFS_Direction_Optimizing bfs;
+            bfs.set_alpha(alpha);
+            bfs.load(g1);
+            bfs.search(0);
+            
+            assert(bfs.get_levels() == expected);
+            
+            // parents must form a valid BFS tree
+            const vector<int>& levels = bfs.get_levels();
+            const vector<int>& parents = bfs.get_parents();
+            for (int v = 1; v < g1.get_num_vertices(); ++ v) {
+                if (levels[v] == -1) {
+                    assert(parents[v] == -1);
+                    continue;
+                }
+                assert(levels[parents[v]] == levels[v] - 1);
+                assert(g1.weight_between(parents[v], v) != -1);
+            }
+            
+            if (alpha == 1000000) {
+                assert(bfs.get_num_bottom_up_steps() > 0);
+            }
+        }
+        
+        // reachability queries
+        BFS_Direction_Optimizing bfs;
+        assert(bfs.in_graph(g1, 0));
+        assert(!bfs.in_graph(g1, 299));
+        
+        // the snapshot follows the graph it is asked about
+        Graph g2 = g1;
+        g2.add_edge(0, 299);
+        assert(g2.get_revision() != g1.get_revision());
+        assert(bfs.in_graph(g2, 299));
+        assert(!bfs.in_graph(g1, 299));
+        g1.add_edge(0, 299);
+        assert(bfs.in_graph(g1, 299));
+    }
+    
+    cout << "Test direction optimizing BFS passed!" << endl;
+}
+
+void test_bfs_parallel() {
+    
+    Graph::Mode modes[] = { Graph::Mode::ADJ_LIST, Graph::Mode::ADJ_MATRIX };
+    for (Graph::Mode mode : modes) {
+        
+        // pseudo random directed graph
+        Graph g1;
+        g1.set_num_vertices(400);
+        g1.set_directed(true);
+        g1.set_graph_representation(mode);
+        
+        unsigned seed = 7;
+        for (int i = 0; i < 2000; ++ i) {
+            seed = seed * 1103515245 + 12345;
+            int from = (seed >> 8) % 350;
+            seed = seed * 1103515245 + 12345;
+            int to = (seed >> 8) % 350;
+            g1.add_edge(from, to);
+        }
+        
+        // direction optimizing BFS is the reference
+        BFS_Direction_Optimizing reference;
+        reference.load(g1);
+        reference.search(0);
+        
+        BFS_Parallel bfs(4);
+        bfs.set_grain(4);
+        bfs.search(g1, 0);
+        assert(bfs.get_levels() == reference.get_levels());
+        
+        // reachability queries
+        assert(bfs.in_graph(g1, 0));
+        assert(!bfs.in_graph(g1, 399));
+        for (int v = 0; v < g1.get_num_vertices(); ++ v) {
+            assert(bfs.in_graph(g1, v) == (reference.get_levels()[v] != -1));
+        }
+    }
+    
+    cout << "Test parallel BFS passed!" << endl;
+}
+
+// check an order is a valid topological order of graph
+bool is_topological_order(const Graph& graph, const vector<int>& order) {
+    if (order.size() != static_cast<size_t>(graph.get_num_vertices())) {
+        return false;
+    }
+    vector<int> position(graph.get_num_vertices());
+    for (size_t i = 0; i < order.size(); ++ i) {
+        position[order[i]] = static_cast<int>(i);
+    }
+    for (auto& edge : graph.get_edges()) {
+        if (position[edge[0]] >= position[edge[1]]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_dfs_iterative() {
+    
+    // SCCs: {0, 1, 2}, {3, 4}, {5}
+    Graph g1;
+    g1.set_num_vertices(6);
+    g1.set_directed(true);
+    g1.set_graph_representation(Graph::Mode::ADJ_LIST);
+    
+    g1.add_edge(0, 1);
+    g1.add_edge(1, 2);
+    g1.add_edge(2, 0);
+    g1.add_edge(2, 3);
+    g1.add_edge(3, 4);
+    g1.add_edge(4, 3);
+    g1.add_edge(4, 5);
+    
+    DFS_Iterative dfs;
+    assert(dfs.strongly_connected_components(g1) == 3);
+    const vector<int>& comps = dfs.get_components();
+    assert(comps[0] == comps[1] && comps[1] == comps[2]);
+    assert(comps[3] == comps[4]);
+    // reverse topological order of the condensation
+    assert(comps[5] < comps[3] && comps[3] < comps[0]);
+    
+    assert(dfs.has_cycle(g1));
+    assert(!dfs.topological_sort(g1));
+    
+    // DAG
+    Graph g2;
+    g2.set_num_vertices(6);
+    g2.set_directed(true);
+    g2.set_graph_representation(Graph::Mode::ADJ_MATRIX);
+    
+    g2.add_edge(5, 2);
+    g2.add_edge(5, 0);
+    g2.add_edge(4, 0);
+    g2.add_edge(4, 1);
+    g2.add_edge(2, 3);
+    g2.add_edge(3, 1);
+    
+    assert(!dfs.has_cycle(g2));
+    assert(dfs.topological_sort(g2));
+    assert(is_topological_order(g2, dfs.get_order()));
+    assert(dfs.strongly_connected_components(g2) == 6);
+    
+    Topological_Kahn_Parallel kahn(4);
+    kahn.set_grain(1);
+    assert(kahn.sort(g2));
+    assert(is_topological_order(g2, kahn.get_order()));
+    assert(!kahn.sort(g1));
+    
+    // BFS mode cycle detection on directed graphs
+    Search graph_search;
+    graph_search.set_mode(Search::Mode::BFS);
+    assert(graph_search.has_cycle(g1));
+    assert(!graph_search.has_cycle(g2));
+    
+    // undirected: a tree has no cycle, a parallel edge does
+    Graph g3;
+    g3.set_num_vertices(4);
+    g3.set_graph_representation(Graph::Mode::ADJ_LIST);
+    g3.add_edge(0, 1);
+    g3.add_edge(1, 2);
+    g3.add_edge(1, 3);
+    
+    assert(!dfs.has_cycle(g3));
+    assert(!graph_search.has_cycle(g3));
+    g3.add_edge(3, 1);
+    assert(dfs.has_cycle(g3));
+    assert(graph_search.has_cycle(g3));
+    
+    // a path deep enough to overflow a recursive DFS
+    const int depth = 1000000;
+    Graph g4;
+    g4.set_num_vertices(depth);
+    g4.set_directed(true);
+    g4.set_graph_representation(Graph::Mode::ADJ_LIST);
+    for (int v = 0; v + 1 < depth; ++ v) {
+        g4.add_edge(v, v + 1);
+    }
+    
+    assert(dfs.topological_sort(g4));
+    assert(dfs.get_order().front() == 0 && dfs.get_order().back() == depth - 1);
+    assert(dfs.strongly_connected_components(g4) == depth);
+    assert(kahn.sort(g4));
+    assert(is_topological_order(g4, kahn.get_order()));
+    
+    graph_search.set_mode(Search::Mode::DFS);
+    assert(graph_search.in_graph(g4, depth - 1));
+    assert(!graph_search.has_cycle(g4));
+    g4.add_edge(depth - 1, 0);
+    assert(graph_search.has_cycle(g4));
+    
+    cout << "Test iterative DFS passed!" << endl;
+}
+
+template <size_t Words>
+void check_bfs_multi_source(const Graph& graph, const vector<pair<int, int>>& queries) {
+    BFS_Multi_Source<Words> ms_bfs;
+    ms_bfs.load(graph);
+    vector<int> distances = ms_bfs.hop_distances(queries);
+    vector<bool> reachable = ms_bfs.reachable(queries);
+    
+    // compare with one BFS per query
+    BFS_Direction_Optimizing bfs;
+    bfs.load(graph);
+    for (size_t i = 0; i < queries.size(); ++ i) {
+        bfs.search(queries[i].first);
+        assert(distances[i] == bfs.get_levels()[queries[i].second]);
+        assert(reachable[i] == (distances[i] != -1));
+    }
+}
+
+void test_bfs_multi_source() {
+    
+    for (int directed = 0; directed <= 1; ++ directed) {
+        
+        // pseudo random sparse graph
+        Graph g1;
+        g1.set_num_vertices(500);
+        g1.set_directed(directed);
+        g1.set_graph_representation(Graph::Mode::ADJ_LIST);
+        
+        unsigned seed = 3;
+        for (int i = 0; i < 700; ++ i) {
+            seed = seed * 1103515245 + 12345;
+            int from = (seed >> 8) % 480;
+            seed = seed * 1103515245 + 12345;
+            int to = (seed >> 8) % 480;
+            g1.add_edge(from, to);
+        }
+        
+        // more distinct sources than a single batch holds
+        vector<pair<int, int>> queries;
+        for (int i = 0; i < 600; ++ i) {
+            seed = seed * 1103515245 + 12345;
+            int from = (seed >> 8) % 300;
+            seed = seed * 1103515245 + 12345;
+            int to = (seed >> 8) % 500;
+            queries.push_back(make_pair(from, to));
+        }
+        queries.push_back(make_pair(7, 7));
+        
+        check_bfs_multi_source<1>(g1, queries);
+        check_bfs_multi_source<4>(g1, queries);
+    }
+    
+    cout << "Test multi-source BFS passed!" << endl;
+}
+
+void test_reachability_index() {
+    
+    for (int directed = 0; directed <= 1; ++ directed) {
+        
+        // pseudo random graph with a few components
+        Graph g1;
+        g1.set_num_vertices(200);
+        g1.set_directed(directed);
+        g1.set_graph_representation(Graph::Mode::ADJ_LIST);
+        
+        unsigned seed = 11;
+        for (int i = 0; i < 260; ++ i) {
+            seed = seed * 1103515245 + 12345;
+            int from = (seed >> 8) % 190;
+            seed = seed * 1103515245 + 12345;
+            int to = (seed >> 8) % 190;
+            g1.add_edge(from, to);
+        }
+        
+        Reachability_Index index(3, 2);
+        index.build(g1);
+        
+        // round trip through the binary format
+        stringstream ss;
+        index.save(ss);
+        Reachability_Index loaded;
+        assert(loaded.load(ss));
+        
+        // compare every pair with a plain BFS
+        BFS_Direction_Optimizing bfs;
+        bfs.load(g1);
+        int n = g1.get_num_vertices();
+        vector<vector<bool>> expected(n, vector<bool>(n));
+        for (int from = 0; from < n; ++ from) {
+            bfs.search(from);
+            for (int to = 0; to < n; ++ to) {
+                expected[from][to] = bfs.get_levels()[to] != -1;
+                assert(index.reachable(from, to) == expected[from][to]);
+                assert(loaded.reachable(from, to) == expected[from][to]);
+            }
+        }
+        
+        // queries from several threads at once
+        vector<thread> readers;
+        for (int t = 0; t < 4; ++ t) {
+            readers.emplace_back([&index, &expected, n, t]() {
+                for (int from = t; from < n; from += 2) {
+                    for (int to = 0; to < n; ++ to) {
+                        assert(index.reachable(from, to) == expected[from][to]);
+                    }
+                }
+            });
+        }
+        for (thread& reader : readers) {
+            reader.join();
+        }
+    }
+    
+    // garbage is rejected
+    stringstream bad("not an index");
+    Reachability_Index index;
+    assert(!index.load(bad));
+    
+    cout << "Test reachability index passed!" << endl;
+}
+
+// counts events and stops after a given number of discoveries
+struct Counting_Visitor : Default_Visitor {
+    explicit Counting_Visitor(int limit) : limit(limit) {}
+    
+    bool discover_vertex(int vertex) {
+        this->order.push_back(vertex);
+        return static_cast<int>(this->order.size()) < this->limit;
+    }
+    
+    bool examine_edge(int, int) {
+        ++ this->num_edges;
+        return true;
+    }
+    
+    bool finish_vertex(int) {
+        ++ this->num_finished;
+        return true;
+    }
+    
+    int limit;
+    int num_edges = 0;
+    int num_finished = 0;
+    vector<int> order;
+};
+
+void test_traversal() {
+    
+    Graph g1;
+    g1.set_num_vertices(6);
+    g1.set_graph_representation(Graph::Mode::BOTH);
+    
+    g1.add_edge(0, 1);
+    g1.add_edge(1, 2);
+    g1.add_edge(2, 3);
+    g1.add_edge(3, 0);
+    g1.add_edge(4, 2);
+    g1.add_edge(4, 1);
+    g1.add_edge(0, 2);
+    
+    Traversal traversal;
+    
+    // full BFS, every undirected edge gets examined from both ends
+    Counting_Visitor bfs_visitor(100);
+    assert(traversal.bfs(g1, 0, bfs_visitor));
+    assert(bfs_visitor.order == vector<int>({ 0, 1, 3, 2, 4 }));
+    assert(bfs_visitor.num_edges == 14);
+    assert(bfs_visitor.num_finished == 5);
+    
+    // DFS, same order as Search in DFS mode
+    Counting_Visitor dfs_visitor(100);
+    assert(traversal.dfs(g1, 0, dfs_visitor));
+    assert(dfs_visitor.order == vector<int>({ 0, 1, 2, 3, 4 }));
+    assert(dfs_visitor.num_finished == 5);
+    
+    // early stop
+    Counting_Visitor stop_visitor(2);
+    assert(!traversal.dfs(g1, 0, stop_visitor));
+    assert(stop_visitor.order == vector<int>({ 0, 1 }));
+    
+    // paths into a reused buffer
+    Search graph_search;
+    vector<int> path;
+    assert(graph_search.find_path(g1, 3, 4, path));
+    assert(path.size() == 3 && path.front() == 3 && path.back() == 4);
+    assert(graph_search.find_path(g1, 2, 2, path));
+    assert(path == vector<int>({ 2 }));
+    assert(!graph_search.find_path(g1, 0, 5, path));
+    assert(path.empty());
+    
+    graph_search.set_mode(Search::Mode::BFS);
+    graph_search.set_record_path(false);
+    assert(graph_search.in_graph(g1, 4));
+    assert(graph_search.get_path().empty());
+    
+    Shortest_Dijkstra dijkstra;
+    dijkstra.set_mode(Shortest_Dijkstra::Mode::PQ);
+    dijkstra.find_shortest_path(g1, 3, 4);
+    dijkstra.get_path(path);
+    assert(path.front() == 3 && path.back() == 4);
+    
+    MST_Prims prims;
+    prims.build(g1);
+    assert(prims.get_path().front() == 0);
+    
+    MST_Kruskals kruskals;
+    kruskals.build(g1);
+    assert(kruskals.get_path().size() == 4);
+    
+    cout << "Test traversal passed!" << endl;
+}
+
+void test_connected_components() {
+    
+    for (int directed = 0; directed <= 1; ++ directed) {
+        
+        // one big component plus scattered small ones
+        Graph g1;
+        g1.set_num_vertices(5000);
+        g1.set_directed(directed);
+        g1.set_graph_representation(Graph::Mode::ADJ_LIST);
+        
+        // same edges, always undirected, as the reference
+        Graph g2;
+        g2.set_num_vertices(5000);
+        g2.set_graph_representation(Graph::Mode::ADJ_LIST);
+        
+        unsigned seed = 5;
+        for (int i = 0; i < 6000; ++ i) {
+            seed = seed * 1103515245 + 12345;
+            int from = (seed >> 8) % 5000;
+            seed = seed * 1103515245 + 12345;
+            int to = (i < 4000) ? (seed >> 8) % 3000 : from + 1 - 2 * ((seed >> 8) % 2);
+            to = min(4999, max(0, to));
+            g1.add_edge(from, to);
+            g2.add_edge(from, to);
+        }
+        
+        Connected_Components cc(4);
+        cc.set_grain(64);
+        int num_components = cc.build(g1);
+        
+        DFS_Iterative dfs;
+        assert(num_components == dfs.strongly_connected_components(g2));
+        
+        // same partition, ids may differ
+        const vector<int>& comps = cc.get_components();
+        const vector<int>& expected = dfs.get_components();
+        vector<int> mapping(num_components, -1);
+        for (int v = 0; v < g1.get_num_vertices(); ++ v) {
+            if (mapping[comps[v]] == -1) {
+                mapping[comps[v]] = expected[v];
+            }
+            assert(mapping[comps[v]] == expected[v]);
+        }
+        
+        int total = 0;
+        for (int size : cc.get_sizes()) {
+            total += size;
+        }
+        assert(total == g1.get_num_vertices());
+    }
+    
+    cout << "Test connected components passed!" << endl;
+}
+
+void test_versioned_graph() {
+    
+    // a path 0 - 1 - ... - 99 gets built while readers search
+    Graph g1;
+    g1.set_num_vertices(100);
+    g1.set_graph_representation(Graph::Mode::BOTH);
+    
+    Versioned_Graph versioned(g1);
+    assert(versioned.get_version() == 0);
+    
+    atomic<bool> writing(true);
+    vector<thread> readers;
+    for (int r = 0; r < 3; ++ r) {
+        readers.push_back(thread([&]() {
+            Search graph_search;
+            graph_search.set_mode(Search::Mode::BFS);
+            size_t last_version = 0;
+            
+            while (writing) {
+                shared_ptr<const Graph> graph = versioned.pin();
+                size_t num_edges = graph->get_edges().size();
+                
+                // the pinned version never changes under the reader
+                int end = static_cast<int>(num_edges);
+                assert(graph_search.in_graph(*graph, end));
+                assert(end == 99 || !graph_search.in_graph(*graph, end + 1));
+                assert(graph->get_edges().size() == num_edges);
+                
+                // versions only move forward
+                size_t version = versioned.get_version();
+                assert(version >= last_version);
+                last_version = version;
+            }
+        }));
+    }
+    
+    // writer batches edges
+    for (int v = 0; v + 1 < 100; v += 3) {
+        for (int u = v; u < min(v + 3, 99); ++ u) {
+            versioned.add_edge(u, u + 1);
+        }
+        versioned.commit();
+    }
+    writing = false;
+    for (auto& t : readers) {
+        t.join();
+    }
+    
+    assert(versioned.get_version() == 33);
+    assert(versioned.pin()->get_edges().size() == 99);
+    // nothing pending, no new version
+    assert(versioned.commit() == 33);
+    
+    // an old pin keeps its rows while the next version writes its own
+    shared_ptr<const Graph> old_graph = versioned.pin();
+    versioned.add_edge(0, 50, 7);
+    assert(versioned.commit() == 34);
+    assert(old_graph->weight_between(0, 50) == -1);
+    assert(old_graph->weight_between(50, 0) == -1);
+    assert(versioned.pin()->weight_between(0, 50) == 7);
+    assert(versioned.pin()->weight_between(50, 0) == 7);
+    assert(old_graph->weight_between(0, 1) == 1);
+    
+    assert(old_graph->get_edges().size() == 99);
+    assert(versioned.pin()->get_edges().size() == 100);
+    assert(versioned.pin()->get_edges()[99] == vector<int>({0, 50, 7}));
+    
+    // plain copies share rows and edges the same way,
+    // writes to either side stay on that side
+    Graph g2 = g1;
+    g2.add_edge(3, 4, 2);
+    g1.add_edge(4, 5, 3);
+    assert(g1.weight_between(3, 4) == -1 && g1.weight_between(4, 5) == 3);
+    assert(g2.weight_between(3, 4) == 2 && g2.weight_between(4, 5) == -1);
+    assert(g1.get_edges().size() == 1 && g1.get_edges()[0][2] == 3);
+    assert(g2.get_edges().size() == 1 && g2.get_edges()[0][2] == 2);
+    
+    // copies taken inside and at the end of an edge chunk
+    Graph g3;
+    g3.set_num_vertices(1000);
+    g3.set_graph_representation(Graph::Mode::ADJ_LIST);
+    vector<Graph> copies;
+    for (int i = 0; i < 600; ++ i) {
+        if (i == 256 || i == 300) {
+            copies.push_back(g3);
+        }
+        g3.add_edge(i, i + 1, i);
+    }
+    for (Graph& copy : copies) {
+        size_t num_edges = copy.get_edges().size();
+        copy.add_edge(999, 998, -1);
+        assert(copy.get_edges().size() == num_edges + 1);
+        assert(copy.get_edges()[num_edges][2] == -1);
+        int i = 0;
+        for (auto& edge : copy.get_edges()) {
+            assert(edge[2] == (i < (int)num_edges ? i : -1));
+            ++ i;
+        }
+    }
+    assert(g3.get_edges().size() == 600);
+    for (int i = 0; i < 600; ++ i) {
+        assert(g3.get_edges()[i][2] == i);
+    }
+    assert(g3.weight_between(999, 998) == -1);
+    
+    cout << "Test versioned graph passed!" << endl;
+}
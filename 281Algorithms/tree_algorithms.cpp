@@ -10,59 +10,691 @@
 #include <sstream>
 #include <queue>
 #include <cassert>
+#include <vector>
+#include <memory>
+#include <type_traits>
+#include <iterator>
+#include <functional>
+#include <utility>
+#include <string>
+#include <set>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
 
 using namespace std;
 
-// A simple ADT for an AVL tree
+// Slab allocator for fixed size objects, such as tree nodes.
+// Released objects go on a free list for reuse and
+// reset() takes back every object at once.
+// Not thread safe unless set_thread_safe is on, for pools
+// shared by trees that different threads write
+template <typename T>
+class Node_Pool {
+public:
+    
+    // num of objects carved out of each slab
+    explicit Node_Pool(size_t slab_size = 256) {
+        this->slab_size = max<size_t>(1, slab_size);
+    }
+    
+    // no copy, handed out pointers belong to this pool
+    Node_Pool(const Node_Pool&) = delete;
+    Node_Pool& operator=(const Node_Pool&) = delete;
+    
+    // construct an object, reusing a released slot if any
+    template <typename... Args>
+    T* allocate(Args&&... args) {
+        Slot* slot;
+        {
+            unique_lock<mutex> guard = this->guard();
+            slot = this->free_list;
+            if (slot) {
+                this->free_list = slot->next;
+            } else {
+                // current slab used up, move on to the next one
+                while (this->slab_index < this->slabs.size() &&
+                       this->slot_index == this->slabs[this->slab_index].size) {
+                    ++ this->slab_index;
+                    this->slot_index = 0;
+                }
+                if (this->slab_index == this->slabs.size()) {
+                    this->slabs.emplace_back(this->slab_size);
+                }
+                slot = &this->slabs[this->slab_index].slots[this->slot_index ++];
+            }
+        }
+        // the slot is ours now, construct outside the lock
+        return new (&slot->storage) T(std::forward<Args>(args)...);
+    }
+    
+    // make sure the next n allocations need no more than one new slab
+    void reserve(size_t n) {
+        unique_lock<mutex> guard = this->guard();
+        size_t available = 0;
+        for (size_t i = this->slab_index; i < this->slabs.size(); ++ i) {
+            available += this->slabs[i].size;
+        }
+        if (this->slab_index < this->slabs.size()) {
+            available -= this->slot_index;
+        }
+        if (available < n) {
+            this->slabs.emplace_back(n - available);
+        }
+    }
+    
+    // destroy an object and keep its slot for reuse
+    void release(T* object) {
+        object->~T();
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        unique_lock<mutex> guard = this->guard();
+        slot->next = this->free_list;
+        this->free_list = slot;
+    }
+    
+    // take back every slot without touching the objects,
+    // only valid once nothing needs destroying
+    void reset() {
+        unique_lock<mutex> guard = this->guard();
+        this->free_list = nullptr;
+        this->slab_index = 0;
+        this->slot_index = 0;
+    }
+    
+    // num of slots carved out of slabs so far
+    size_t capacity() const {
+        unique_lock<mutex> guard = this->guard();
+        size_t total = 0;
+        for (auto& slab : this->slabs) {
+            total += slab.size;
+        }
+        return total;
+    }
+    
+    // lock around every call, set before other threads use the pool
+    void set_thread_safe(bool thread_safe) {
+        this->thread_safe = thread_safe;
+    }
+    
+private:
+    // a slot either holds an object or links to the next free slot
+    union Slot {
+        Slot* next;
+        typename aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+    
+    // a contiguous run of slots
+    struct Slab {
+        explicit Slab(size_t size) : slots(new Slot[size]), size(size) {}
+        
+        unique_ptr<Slot[]> slots;
+        size_t size;
+    };
+    
+    size_t slab_size;
+    vector<Slab> slabs;
+    // bump position within the slabs
+    size_t slab_index = 0;
+    size_t slot_index = 0;
+    // released slots
+    Slot* free_list = nullptr;
+    // guards everything above when thread safe
+    bool thread_safe = false;
+    mutable mutex lock;
+    
+    // held lock if thread safe, an empty one otherwise
+    unique_lock<mutex> guard() const {
+        if (this->thread_safe) {
+            return unique_lock<mutex>(this->lock);
+        }
+        return unique_lock<mutex>(this->lock, defer_lock);
+    }
+};
+
+// How an AVLTree stores its elements,
+// maps keep <key, value> pairs
+template <typename Key, typename Value>
+struct AVL_Traits {
+    typedef pair<const Key, Value> value_type;
+    
+    static const Key& key(const value_type& data) {
+        return data.first;
+    }
+};
+
+// sets keep the key only
+template <typename Key>
+struct AVL_Traits<Key, void> {
+    typedef const Key value_type;
+    
+    static const Key& key(const Key& data) {
+        return data;
+    }
+};
+
+// Read-only snapshot of an AVLTree for read-mostly phases.
+// Elements sit in one array in Eytzinger (BFS) order, the children
+// of slot k are 2k and 2k + 1, so the top levels share cache lines
+// and a search is a branchless descent that prefetches ahead
+template <typename Key, typename Value = void, typename Compare = less<Key>>
+class Frozen_AVLTree {
+public:
+    typedef typename AVL_Traits<Key, Value>::value_type value_type;
+    
+    // sorted holds the elements in key order
+    Frozen_AVLTree(const vector<const value_type*>& sorted, const Compare& comp)
+    : comp(comp) {
+        vector<size_t> order(sorted.size());
+        size_t next = 0;
+        this->layout(1, order, next);
+        this->data.reserve(sorted.size());
+        for (size_t index : order) {
+            this->data.push_back(*sorted[index]);
+        }
+    }
+    
+    // element with key, nullptr if not found
+    const value_type* find(const Key& key) const {
+        const value_type* result = this->lower_bound(key);
+        if (result && this->comp(key, AVL_Traits<Key, Value>::key(*result))) {
+            return nullptr;
+        }
+        return result;
+    }
+    
+    bool contains(const Key& key) const {
+        return this->find(key) != nullptr;
+    }
+    
+    // first element with key >= key, nullptr if none
+    const value_type* lower_bound(const Key& key) const {
+        size_t n = this->data.size();
+        size_t k = 1;
+        while (k <= n) {
+#ifdef __GNUC__
+            // the 16 slots four levels down are adjacent
+            if (k * PREFETCH_STRIDE <= n) {
+                __builtin_prefetch(&this->data[k * PREFETCH_STRIDE - 1]);
+            }
+#endif
+            k = 2 * k + this->comp(AVL_Traits<Key, Value>::key(this->data[k - 1]), key);
+        }
+        // undo the right turns taken after the last left turn
+        while (k & 1) {
+            k >>= 1;
+        }
+        k >>= 1;
+        return k ? &this->data[k - 1] : nullptr;
+    }
+    
+    size_t num_elements() const {
+        return this->data.size();
+    }
+    
+    bool empty() const {
+        return this->data.empty();
+    }
+    
+private:
+    static const size_t PREFETCH_STRIDE = 16;
+    
+    vector<typename remove_const<value_type>::type> data;
+    Compare comp;
+    
+    // in-order walk of the implicit tree hands out sorted positions
+    void layout(size_t k, vector<size_t>& order, size_t& next) {
+        if (k > order.size()) {
+            return;
+        }
+        this->layout(2 * k, order, next);
+        order[k - 1] = next ++;
+        this->layout(2 * k + 1, order, next);
+    }
+};
+
+// A simple ADT for an AVL tree,
+// an ordered set, or an ordered map when given a Value type
+template <typename Key, typename Value = void, typename Compare = less<Key>>
 class AVLTree {
 public:
+    typedef Key key_type;
+    typedef typename AVL_Traits<Key, Value>::value_type value_type;
+    typedef Compare key_compare;
+    
     // Tree node
     struct Node {
-        Node(int val) {
-            this->val = val;
-            this->height = 1; // default to 1 as a leaf node
+        template <typename... Args>
+        explicit Node(Args&&... args) : data(std::forward<Args>(args)...) {}
+        
+        const Key& key() const {
+            return AVL_Traits<Key, Value>::key(this->data);
         }
-        int val;
-        int height;
+        
+        value_type data;
+        int height = 1; // default to 1 as a leaf node
+        size_t subtree_size = 1; // num of nodes rooted here
         Node* left = nullptr;
         Node* right = nullptr;
+        Node* parent = nullptr;
+    };
+    
+    // node allocator type, for caller supplied arenas
+    typedef Node_Pool<Node> Arena;
+    
+    // Bidirectional in-order iterator, walks parent pointers
+    // so it needs neither recursion nor a stack
+    template <bool Is_Const>
+    class Basic_Iterator {
+    public:
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef typename remove_const<typename AVLTree::value_type>::type value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename conditional<Is_Const, const value_type&,
+                                     typename AVLTree::value_type&>::type reference;
+        typedef typename conditional<Is_Const, const value_type*,
+                                     typename AVLTree::value_type*>::type pointer;
+        
+        Basic_Iterator() {}
+        
+        Basic_Iterator(Node* node, const AVLTree* tree) {
+            this->node = node;
+            this->tree = tree;
+        }
+        
+        // iterator converts to const_iterator
+        operator Basic_Iterator<true>() const {
+            return Basic_Iterator<true>(this->node, this->tree);
+        }
+        
+        reference operator*() const {
+            return this->node->data;
+        }
+        
+        pointer operator->() const {
+            return &this->node->data;
+        }
+        
+        // in-order successor
+        Basic_Iterator& operator++() {
+            this->node = AVLTree::successor(this->node);
+            return *this;
+        }
+        
+        Basic_Iterator operator++(int) {
+            Basic_Iterator copy = *this;
+            ++ *this;
+            return copy;
+        }
+        
+        // in-order predecessor, end() steps back to the maximum
+        Basic_Iterator& operator--() {
+            if (this->node) {
+                this->node = AVLTree::predecessor(this->node);
+            } else {
+                this->node = AVLTree::max_node(this->tree->root);
+            }
+            return *this;
+        }
+        
+        Basic_Iterator operator--(int) {
+            Basic_Iterator copy = *this;
+            -- *this;
+            return copy;
+        }
+        
+        bool operator==(const Basic_Iterator& rhs) const {
+            return this->node == rhs.node;
+        }
+        
+        bool operator!=(const Basic_Iterator& rhs) const {
+            return !(*this == rhs);
+        }
+        
+        // underlying node, nullptr for end()
+        Node* get_node() const {
+            return this->node;
+        }
+        
+    private:
+        Node* node = nullptr;
+        const AVLTree* tree = nullptr;
     };
     
+    typedef Basic_Iterator<false> iterator;
+    typedef Basic_Iterator<true> const_iterator;
+    
     // root node
     Node* root = nullptr;
     
-    // get rid of compiler warning
-    AVLTree(){}
+    // nodes come from a pool owned by this tree
+    explicit AVLTree(const Compare& comp = Compare()) : comp(comp) {}
+    
+    // nodes come from a caller supplied arena,
+    // which must outlive the tree and may be shared by several trees
+    explicit AVLTree(Arena& arena, const Compare& comp = Compare()) : comp(comp) {
+        this->pool = &arena;
+    }
     
     // init a value at root
-    explicit AVLTree(int val) {
-        this->root = new Node(val);
+    explicit AVLTree(const value_type& val) {
+        this->insert(val);
+    }
+    
+    // no copy, nodes belong to the pool
+    AVLTree(const AVLTree&) = delete;
+    AVLTree& operator=(const AVLTree&) = delete;
+    
+    // move, the nodes and their pool go along
+    AVLTree(AVLTree&& rhs) : comp(rhs.comp) {
+        this->steal(rhs);
+    }
+    
+    AVLTree& operator=(AVLTree&& rhs) {
+        if (this != &rhs) {
+            this->clear();
+            this->comp = rhs.comp;
+            this->steal(rhs);
+        }
+        return *this;
+    }
+    
+    // iterators
+    iterator begin() {
+        return iterator(min_node(this->root), this);
+    }
+    
+    const_iterator begin() const {
+        return const_iterator(min_node(this->root), this);
+    }
+    
+    iterator end() {
+        return iterator(nullptr, this);
+    }
+    
+    const_iterator end() const {
+        return const_iterator(nullptr, this);
     }
     
     // find a node with value
-    Node* find(int val) const {
-        return this->_find_impl(this->root, val);
+    iterator find(const Key& key) {
+        return iterator(this->_find_impl(key), this);
     }
     
-    // insert a new node
-    Node* insert(int val) {
-        Node* n = this->_insert_impl(this->root, val);
+    const_iterator find(const Key& key) const {
+        return const_iterator(this->_find_impl(key), this);
+    }
+    
+    // check whether a value is in the tree
+    bool contains(const Key& key) const {
+        return this->_find_impl(key) != nullptr;
+    }
+    
+    // first element with key >= key
+    iterator lower_bound(const Key& key) {
+        return iterator(this->_lower_bound_impl(key), this);
+    }
+    
+    const_iterator lower_bound(const Key& key) const {
+        return const_iterator(this->_lower_bound_impl(key), this);
+    }
+    
+    // first element with key > key
+    iterator upper_bound(const Key& key) {
+        return iterator(this->_upper_bound_impl(key), this);
+    }
+    
+    const_iterator upper_bound(const Key& key) const {
+        return const_iterator(this->_upper_bound_impl(key), this);
+    }
+    
+    // visit every element with key in [lo, hi) in order,
+    // only the nodes in range and the path to lo get touched
+    template <typename Visit>
+    void range(const Key& lo, const Key& hi, Visit visit) const {
+        for (const_iterator it = this->lower_bound(lo);
+             it != this->end() && this->comp(it.get_node()->key(), hi); ++ it) {
+            visit(*it);
+        }
+    }
+    
+    // k-th smallest element, counting from 0, end() if out of range
+    iterator select(size_t k) {
+        return iterator(this->_select_impl(k), this);
+    }
+    
+    const_iterator select(size_t k) const {
+        return const_iterator(this->_select_impl(k), this);
+    }
+    
+    // num of elements with key < key
+    size_t rank(const Key& key) const {
+        size_t result = 0;
+        Node* current = this->root;
+        while (current) {
+            if (this->comp(current->key(), key)) {
+                // current and its whole left subtree are smaller
+                result += this->subtree_size(current->left) + 1;
+                current = current->right;
+            } else {
+                current = current->left;
+            }
+        }
+        return result;
+    }
+    
+    // num of elements with key in [lo, hi)
+    size_t count_range(const Key& lo, const Key& hi) const {
+        if (!this->comp(lo, hi)) {
+            return 0;
+        }
+        return this->rank(hi) - this->rank(lo);
+    }
+    
+    // read-only copy laid out for fast searching,
+    // the tree stays free to change afterwards
+    Frozen_AVLTree<Key, Value, Compare> freeze() const {
+        vector<const value_type*> sorted;
+        sorted.reserve(this->size);
+        for (const_iterator it = this->begin(); it != this->end(); ++ it) {
+            sorted.push_back(&*it);
+        }
+        return Frozen_AVLTree<Key, Value, Compare>(sorted, this->comp);
+    }
+    
+    // construct an element in place, the node is built first so
+    // move-only values work; nothing happens if the key already exists
+    // return the element with that key and whether it was inserted
+    template <typename... Args>
+    pair<iterator, bool> emplace(Args&&... args) {
+        Node* node = this->node_pool()->allocate(std::forward<Args>(args)...);
+        
+        // find path to insert based on value
+        Node* parent = nullptr;
+        Node* current = this->root;
+        bool go_left = false;
+        while (current) {
+            parent = current;
+            if (this->comp(node->key(), current->key())) {
+                go_left = true;
+                current = current->left;
+            } else if (this->comp(current->key(), node->key())) {
+                go_left = false;
+                current = current->right;
+            } else {
+                // equal, keep the existing one
+                this->pool->release(node);
+                return make_pair(iterator(current, this), false);
+            }
+        }
+        
+        // hang the new leaf
+        node->parent = parent;
+        if (!parent) {
+            this->root = node;
+        } else if (go_left) {
+            parent->left = node;
+        } else {
+            parent->right = node;
+        }
         ++ this->size;
-        this->root = n;
-        return n;
+        
+        // update heights and check balance up to the root
+        this->rebalance_up(parent);
+        return make_pair(iterator(node, this), true);
     }
     
-    // delete an node
-    Node* remove(int val) {
-        Node* n = this->_remove_impl(this->root, val);
+    // insert a new node
+    pair<iterator, bool> insert(const value_type& val) {
+        return this->emplace(val);
+    }
+    
+    pair<iterator, bool> insert(typename remove_const<value_type>::type&& val) {
+        return this->emplace(std::move(val));
+    }
+    
+    // delete the node with key
+    // return whether anything was removed
+    bool remove(const Key& key) {
+        Node* node = this->_find_impl(key);
+        if (!node) {
+            return false;
+        }
+        this->erase(iterator(node, this));
+        return true;
+    }
+    
+    // delete the node at it, return the element after it
+    iterator erase(iterator it) {
+        Node* node = it.get_node();
+        Node* next = successor(node);
+        // node to start rebalancing from
+        Node* start;
+        
+        if (node->left && node->right) {
+            // two children, the in-order successor takes over
+            // node's place (next is the minimum of the right subtree)
+            if (next->parent != node) {
+                start = next->parent;
+                this->transplant(next, next->right);
+                next->right = node->right;
+                next->right->parent = next;
+            } else {
+                start = next;
+            }
+            this->transplant(node, next);
+            next->left = node->left;
+            next->left->parent = next;
+            next->height = node->height;
+        } else {
+            // at most one child, splice it in
+            start = node->parent;
+            this->transplant(node, node->left ? node->left : node->right);
+        }
+        
+        this->pool->release(node);
         -- this->size;
-        this->root = n;
-        return n;
+        this->rebalance_up(start);
+        return iterator(next, this);
+    }
+    
+    // replace the contents with a sorted range of unique elements in O(n),
+    // nodes are allocated in one pass and then linked into a balanced tree
+    template <typename It>
+    void build_sorted(It first, It last) {
+        this->clear();
+        size_t n = distance(first, last);
+        this->node_pool()->reserve(n);
+        
+        vector<Node*> nodes;
+        nodes.reserve(n);
+        for (; first != last; ++ first) {
+            nodes.push_back(this->pool->allocate(*first));
+            // input must be strictly increasing
+            assert(nodes.size() == 1 ||
+                   this->comp(nodes[nodes.size() - 2]->key(), nodes.back()->key()));
+        }
+        this->set_root(this->link_sorted(nodes, 0, n));
+    }
+    
+    // move every element with key >= key into a new tree and return it,
+    // this tree keeps the smaller ones, both share the same pool
+    AVLTree split(const Key& key) {
+        Node* l;
+        Node* mid;
+        Node* r;
+        this->split_impl(this->root, key, l, mid, r);
+        // key itself goes to the upper part
+        if (mid) {
+            r = this->join_impl(nullptr, mid, r);
+        }
+        
+        AVLTree upper(this->comp);
+        upper.pool = this->pool;
+        upper.own_pool = this->own_pool;
+        upper.set_root(r);
+        this->set_root(l);
+        return upper;
+    }
+    
+    // append a tree whose keys all come after ours in O(log n),
+    // right is left empty
+    void join(AVLTree&& right) {
+        Node* r = this->adopt(right);
+        if (!r) {
+            return;
+        }
+        if (!this->root) {
+            this->set_root(r);
+            return;
+        }
+        // detach the minimum of right as the joining node
+        Node* l;
+        Node* mid;
+        this->split_impl(r, min_node(r)->key(), l, mid, r);
+        assert(this->comp(max_node(this->root)->key(), mid->key()));
+        this->set_root(this->join_impl(this->root, mid, r));
+    }
+    
+    // set union through split and join, every element of other moves
+    // into this tree and other is left empty; on equal keys ours stays.
+    // Independent halves of large inputs run on separate threads
+    void merge(AVLTree&& other) {
+        Node* other_root = this->adopt(other);
+        
+        // one level of spawning per doubling of hardware threads
+        int spawn_depth = 0;
+        for (unsigned n = thread::hardware_concurrency(); n > 1; n >>= 1) {
+            ++ spawn_depth;
+        }
+        
+        vector<Node*> duplicates;
+        this->set_root(this->union_impl(this->root, other_root, duplicates, spawn_depth));
+        // the threads only relink nodes, the pool is touched here alone
+        for (Node* node : duplicates) {
+            this->pool->release(node);
+        }
+    }
+    
+    // let trees split off this one be written from different threads,
+    // set before they start; every allocation takes a lock from then on
+    void set_thread_safe(bool thread_safe) {
+        this->node_pool()->set_thread_safe(thread_safe);
     }
     
     // clear the contents of this tree
+    // O(1) when the tree is the only user of its own pool
+    // and elements need no destructor
     void clear() {
-        this->destroy(this->root);
+        if (this->own_pool && this->own_pool.use_count() == 1 &&
+            is_trivially_destructible<value_type>::value) {
+            this->own_pool->reset();
+        } else {
+            this->destroy(this->root);
+        }
         this->root = nullptr;
         this->size = 0;
     }
@@ -72,6 +704,10 @@ public:
         return this->size;
     }
     
+    bool empty() const {
+        return this->size == 0;
+    }
+    
     // get height
     int height(Node* root) const {
         if (!root) {
@@ -80,9 +716,18 @@ public:
         return root->height;
     }
     
-    // update node's height
+    // get num of nodes in a subtree
+    size_t subtree_size(Node* root) const {
+        if (!root) {
+            return 0;
+        }
+        return root->subtree_size;
+    }
+    
+    // update node's height, along with its subtree size
     Node* update_height(Node* node) {
         node->height = max(this->height(node->left), this->height(node->right)) + 1;
+        node->subtree_size = this->subtree_size(node->left) + this->subtree_size(node->right) + 1;
         return node;
     }
     
@@ -91,7 +736,7 @@ public:
         if (root == nullptr) {
             return;
         }
-        oss << root->val << ' ';
+        oss << root->key() << ' ';
         this->pre_order(root->left, oss);
         this->pre_order(root->right, oss);
     }
@@ -101,7 +746,7 @@ public:
             return;
         }
         this->in_order(root->left, oss);
-        oss << root->val << ' ';
+        oss << root->key() << ' ';
         this->in_order(root->right, oss);
     }
     
@@ -111,20 +756,23 @@ public:
         }
         this->post_order(root->left, oss);
         this->post_order(root->right, oss);
-        oss << root->val << ' ';
+        oss << root->key() << ' ';
     }
     
     void level_order(Node* root, ostream& oss) const {
+        if (root == nullptr) {
+            return;
+        }
         // init a queue for BFS
         queue<Node*> q;
         // visit root
-        q.push(this->root);
+        q.push(root);
         while (!q.empty()) {
             // get first node
             Node* current = q.front();
             q.pop();
             // print current
-            oss << current->val << ' ';
+            oss << current->key() << ' ';
             // get its children and push into queue
             if (current->left) q.push(current->left);
             if (current->right) q.push(current->right);
@@ -133,120 +781,319 @@ public:
     
     // destructor
     ~AVLTree() {
-        // destroy all nodes
-        this->destroy(this->root);
+        // an owned pool frees its slabs by itself, anything
+        // else, or elements with destructors, go back one by one
+        if (!this->own_pool || this->own_pool.use_count() > 1 ||
+            !is_trivially_destructible<value_type>::value) {
+            this->destroy(this->root);
+        }
     }
     
 private:
     // size
     size_t size = 0;
+    // key ordering
+    Compare comp;
+    // node allocator, an owned one is created on first use
+    // and is shared with the trees split off this one
+    Arena* pool = nullptr;
+    shared_ptr<Arena> own_pool;
     
-    // tree operation implementations
-    Node* _find_impl(Node* root, int val) const {
-        if (!root) return nullptr;
-        if (root->val == val) return root;
-        
-        Node* l = this->_find_impl(root->left, val);
-        Node* r = this->_find_impl(root->right, val);
-        
-        if (l) return l;
-        if (r) return r;
-        
-        return nullptr;
+    // combined subtree size above which merge spawns a thread
+    static const size_t PARALLEL_CUTOFF = 1 << 16;
+    
+    Arena* node_pool() {
+        if (!this->pool) {
+            this->own_pool.reset(new Arena());
+            this->pool = this->own_pool.get();
+        }
+        return this->pool;
     }
     
-    Node* _insert_impl(Node* node, int val) {
-        // if no value at root
-        if (!node) return new Node(val);
-        
-        // find path to insert based on value
-        if (val < node->val) {
-            node->left = this->_insert_impl(node->left, val);
-        } else if (val > node->val) {
-            node->right = this->_insert_impl(node->right, val);
-        } else {
-            // @NOTICE: equal, disallow or use other strategies
-            return node;
+    // make node the root, recounting the elements
+    void set_root(Node* node) {
+        this->root = node;
+        if (node) {
+            node->parent = nullptr;
         }
-        
-        // update height of the node
-        node = this->update_height(node);
-        // check balance
-        return this->check_balance(node);
+        this->size = this->subtree_size(node);
     }
     
-    Node* _remove_impl(Node* node, int val) {
-        
-        if (!node) return node;
-        
-        // search through left/right subtree
-        if (val < node->val) {
-            node->left = this->_remove_impl(node->left, val);
+    // take the nodes of other, returning their root and leaving other
+    // empty; nodes living in a different pool get moved into ours
+    Node* adopt(AVLTree& other) {
+        Node* result = other.root;
+        if (result && !this->pool) {
+            // nothing allocated yet, share other's pool
+            this->pool = other.pool;
+            this->own_pool = other.own_pool;
+        } else if (result && this->pool != other.pool) {
+            vector<Node*> nodes;
+            nodes.reserve(other.size);
+            this->pool->reserve(other.size);
+            for (auto it = other.begin(); it != other.end(); ++ it) {
+                nodes.push_back(this->pool->allocate(std::move(*it)));
+            }
+            other.clear();
+            result = this->link_sorted(nodes, 0, nodes.size());
         }
-        if (val > node->val) {
-            node->right = this->_remove_impl(node->right, val);
+        if (result) {
+            result->parent = nullptr;
         }
-        // equal, found the node
-        if (val == node->val) {
-            // if node has no children
-            if (!node->left && !node->right) {
-                delete node;
-                node = nullptr;
+        other.root = nullptr;
+        other.size = 0;
+        return result;
+    }
+    
+    // take over everything rhs has, leaving it empty
+    void steal(AVLTree& rhs) {
+        this->root = rhs.root;
+        this->size = rhs.size;
+        this->pool = rhs.pool;
+        this->own_pool = std::move(rhs.own_pool);
+        rhs.root = nullptr;
+        rhs.size = 0;
+        rhs.pool = nullptr;
+    }
+    
+    // tree operation implementations
+    Node* _find_impl(const Key& key) const {
+        // follow the ordering down a single path
+        Node* current = this->root;
+        while (current) {
+            if (this->comp(key, current->key())) {
+                current = current->left;
+            } else if (this->comp(current->key(), key)) {
+                current = current->right;
+            } else {
+                return current;
             }
-            // two children
-            else if (node->left && node->right) {
-                // find minimum node in the right subtree
-                // or the in-order successor
-                Node* min = node->right;
-                while (min->left != nullptr) {
-                    min = min->left;
-                }
-                // copy over that value
-                node->val = min->val;
-                // now remove the one with the same value in the subtree
-                node->right = this->_remove_impl(node->right, min->val);
-            }
-            // one children
-            else {
-                Node* child;
-                if (node->left == nullptr) {
-                    child = node->right;
-                    node->right = nullptr;
-                } else {
-                    child = node->left;
-                    node->left = nullptr;
-                }
-                // copy over child value
-                node->val = child->val;
-                // destroy child
-                delete child;
-                child = nullptr;
+        }
+        return nullptr;
+    }
+    
+    Node* _lower_bound_impl(const Key& key) const {
+        Node* result = nullptr;
+        Node* current = this->root;
+        while (current) {
+            if (this->comp(current->key(), key)) {
+                current = current->right;
+            } else {
+                // candidate, look for a smaller one on the left
+                result = current;
+                current = current->left;
             }
         }
-        
-        // if root got deleted
-        if (!node) return node;
-        
-        // update node weight for AVL
-        node = this->update_height(node);
-        
-        // check balance and adjust
-        return this->check_balance(node);
+        return result;
     }
     
-    // check balance of a node and adjust
-    Node* check_balance(Node* node) {
-        // check balance
-        int balance = this->balance(node);
-        
-        // left left
-        if (balance > 1 && this->balance(node->left) >= 0) {
-            return this->right_rotate(node);
+    Node* _upper_bound_impl(const Key& key) const {
+        Node* result = nullptr;
+        Node* current = this->root;
+        while (current) {
+            if (this->comp(key, current->key())) {
+                result = current;
+                current = current->left;
+            } else {
+                current = current->right;
+            }
         }
-        
-        // right right
-        if (balance < -1 && this->balance(node->right) <= 0) {
-            return this->left_rotate(node);
+        return result;
+    }
+    
+    Node* _select_impl(size_t k) const {
+        Node* current = this->root;
+        while (current) {
+            size_t left_size = this->subtree_size(current->left);
+            if (k < left_size) {
+                current = current->left;
+            } else if (k == left_size) {
+                return current;
+            } else {
+                // skip current and its left subtree
+                k -= left_size + 1;
+                current = current->right;
+            }
+        }
+        return nullptr;
+    }
+    
+    // link sorted nodes[lo, hi) into a perfectly balanced subtree
+    Node* link_sorted(const vector<Node*>& nodes, size_t lo, size_t hi) {
+        if (lo >= hi) {
+            return nullptr;
+        }
+        size_t mid = lo + (hi - lo) / 2;
+        return this->make_node(this->link_sorted(nodes, lo, mid),
+                               nodes[mid],
+                               this->link_sorted(nodes, mid + 1, hi));
+    }
+    
+    // hang l and r under k
+    Node* make_node(Node* l, Node* k, Node* r) {
+        k->left = l;
+        k->right = r;
+        if (l) l->parent = k;
+        if (r) r->parent = k;
+        return this->update_height(k);
+    }
+    
+    // AVL join, all keys of l < k < all keys of r
+    // descend the taller side until heights match, then rebalance up
+    Node* join_impl(Node* l, Node* k, Node* r) {
+        if (this->height(l) > this->height(r) + 1) {
+            return this->join_right(l, k, r);
+        }
+        if (this->height(r) > this->height(l) + 1) {
+            return this->join_left(l, k, r);
+        }
+        return this->make_node(l, k, r);
+    }
+    
+    // l is taller, walk down its right spine
+    Node* join_right(Node* l, Node* k, Node* r) {
+        Node* ll = l->left;
+        Node* c = l->right;
+        if (this->height(c) <= this->height(r) + 1) {
+            Node* t = this->make_node(c, k, r);
+            if (this->height(t) <= this->height(ll) + 1) {
+                return this->make_node(ll, l, t);
+            }
+            return this->left_rotate(this->make_node(ll, l, this->right_rotate(t)));
+        }
+        Node* t = this->join_right(c, k, r);
+        Node* joined = this->make_node(ll, l, t);
+        if (this->height(t) <= this->height(ll) + 1) {
+            return joined;
+        }
+        return this->left_rotate(joined);
+    }
+    
+    // r is taller, walk down its left spine
+    Node* join_left(Node* l, Node* k, Node* r) {
+        Node* c = r->left;
+        Node* rr = r->right;
+        if (this->height(c) <= this->height(l) + 1) {
+            Node* t = this->make_node(l, k, c);
+            if (this->height(t) <= this->height(rr) + 1) {
+                return this->make_node(t, r, rr);
+            }
+            return this->right_rotate(this->make_node(this->left_rotate(t), r, rr));
+        }
+        Node* t = this->join_left(l, k, c);
+        Node* joined = this->make_node(t, r, rr);
+        if (this->height(t) <= this->height(rr) + 1) {
+            return joined;
+        }
+        return this->right_rotate(joined);
+    }
+    
+    // split a subtree into keys < key, the node with key (if any)
+    // and keys > key; resulting roots may keep stale parent pointers
+    void split_impl(Node* t, const Key& key, Node*& l, Node*& mid, Node*& r) {
+        if (!t) {
+            l = mid = r = nullptr;
+            return;
+        }
+        Node* tl = t->left;
+        Node* tr = t->right;
+        if (this->comp(key, t->key())) {
+            Node* rl;
+            this->split_impl(tl, key, l, mid, rl);
+            r = this->join_impl(rl, t, tr);
+        } else if (this->comp(t->key(), key)) {
+            Node* lr;
+            this->split_impl(tr, key, lr, mid, r);
+            l = this->join_impl(tl, t, lr);
+        } else {
+            l = tl;
+            r = tr;
+            mid = this->make_node(nullptr, t, nullptr);
+        }
+    }
+    
+    // union of two subtrees, nodes of t2 with keys already in t1
+    // end up in duplicates
+    Node* union_impl(Node* t1, Node* t2, vector<Node*>& duplicates, int spawn_depth) {
+        if (!t1) return t2;
+        if (!t2) return t1;
+        
+        size_t total = t1->subtree_size + t2->subtree_size;
+        Node* l1 = t1->left;
+        Node* r1 = t1->right;
+        Node* l2;
+        Node* mid;
+        Node* r2;
+        this->split_impl(t2, t1->key(), l2, mid, r2);
+        if (mid) {
+            duplicates.push_back(mid);
+        }
+        
+        // both halves touch disjoint nodes
+        Node* l;
+        Node* r;
+        if (spawn_depth > 0 && total >= PARALLEL_CUTOFF) {
+            vector<Node*> left_duplicates;
+            future<Node*> left = async(launch::async, [&]() {
+                return this->union_impl(l1, l2, left_duplicates, spawn_depth - 1);
+            });
+            r = this->union_impl(r1, r2, duplicates, spawn_depth - 1);
+            l = left.get();
+            duplicates.insert(duplicates.end(), left_duplicates.begin(), left_duplicates.end());
+        } else {
+            l = this->union_impl(l1, l2, duplicates, 0);
+            r = this->union_impl(r1, r2, duplicates, 0);
+        }
+        return this->join_impl(l, t1, r);
+    }
+    
+    // put v where u was under u's parent
+    void transplant(Node* u, Node* v) {
+        if (!u->parent) {
+            this->root = v;
+        } else if (u == u->parent->left) {
+            u->parent->left = v;
+        } else {
+            u->parent->right = v;
+        }
+        if (v) {
+            v->parent = u->parent;
+        }
+    }
+    
+    // walk from node to the root fixing heights and balance
+    void rebalance_up(Node* node) {
+        while (node) {
+            Node* parent = node->parent;
+            this->update_height(node);
+            Node* subtree = this->check_balance(node);
+            if (subtree != node) {
+                // rotated, hang the new subtree root where node was
+                if (!parent) {
+                    this->root = subtree;
+                } else if (parent->left == node) {
+                    parent->left = subtree;
+                } else {
+                    parent->right = subtree;
+                }
+            }
+            node = parent;
+        }
+    }
+    
+    // check balance of a node and adjust
+    Node* check_balance(Node* node) {
+        // check balance
+        int balance = this->balance(node);
+        
+        // left left
+        if (balance > 1 && this->balance(node->left) >= 0) {
+            return this->right_rotate(node);
+        }
+        
+        // right right
+        if (balance < -1 && this->balance(node->right) <= 0) {
+            return this->left_rotate(node);
         }
         
         // left right
@@ -279,6 +1126,10 @@ private:
         // rotate
         r->left = node;
         node->right = l;
+        // fix parents, caller links r into node's old place
+        if (l) l->parent = node;
+        r->parent = node->parent;
+        node->parent = r;
         // update tree height
         this->update_height(node);
         this->update_height(r);
@@ -292,6 +1143,10 @@ private:
         // rotate
         l->right = node;
         node->left = r;
+        // fix parents, caller links l into node's old place
+        if (r) r->parent = node;
+        l->parent = node->parent;
+        node->parent = l;
         // update tree height
         this->update_height(node);
         this->update_height(l);
@@ -299,23 +1154,933 @@ private:
         return l; // new root
     }
     
-    // destroy the tree
+    // extreme nodes of a subtree
+    static Node* min_node(Node* node) {
+        while (node && node->left) {
+            node = node->left;
+        }
+        return node;
+    }
+    
+    static Node* max_node(Node* node) {
+        while (node && node->right) {
+            node = node->right;
+        }
+        return node;
+    }
+    
+    // in-order neighbours through parent pointers
+    static Node* successor(Node* node) {
+        if (node->right) {
+            return min_node(node->right);
+        }
+        // climb until coming up from a left child
+        while (node->parent && node == node->parent->right) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+    
+    static Node* predecessor(Node* node) {
+        if (node->left) {
+            return max_node(node->left);
+        }
+        while (node->parent && node == node->parent->left) {
+            node = node->parent;
+        }
+        return node->parent;
+    }
+    
+    // destroy the tree, handing every node back to the pool
     void destroy(Node* root) {
         if (!root) return;
-        if (!root->left && !root->right) {
-            // leaf
-            delete root;
-            root = nullptr;
-            return;
-        }
         // destroy subtrees
         this->destroy(root->left);
         this->destroy(root->right);
+        this->pool->release(root);
+    }
+};
+
+// Concurrent AVL set after Bronson et al., "A Practical Concurrent
+// Binary Search Tree". Readers take no locks, they walk down and
+// validate each step against the parent's version number, retrying
+// if a rotation moved keys out of the subtree they were in.
+// Writers lock only the nodes they link, unlink or rotate, always
+// parent before child. Removing a node with two children only marks
+// it absent, it stays as a routing node until it can be unlinked.
+// Unlinked nodes may still be read, so they are freed by epochs: every
+// operation announces the global epoch in its thread's record, a node
+// unlinked in epoch e goes on its thread's retired list and is freed by
+// that thread once the epoch reaches e + 2, when no operation that could
+// have seen it is left. The epoch moves on once every thread inside the
+// tree has announced the current one. Less than a batch or so per thread
+// stays behind until that thread's next update, reclaim() or destruction.
+// Key needs a default constructor for the sentinel above the root
+template <typename Key, typename Compare = less<Key>>
+class Concurrent_AVLTree {
+public:
+    explicit Concurrent_AVLTree(const Compare& comp = Compare())
+    : comp(comp), holder(new Node(Key(), nullptr, false)), id(next_id()) {}
+    
+    Concurrent_AVLTree(const Concurrent_AVLTree&) = delete;
+    Concurrent_AVLTree& operator=(const Concurrent_AVLTree&) = delete;
+    
+    ~Concurrent_AVLTree() {
+        this->destroy(this->holder);
+        this->reclaim();
+        Participant* record = this->participants.load();
+        while (record) {
+            Participant* next = record->next;
+            delete record;
+            record = next;
+        }
+    }
+    
+    // check whether key is in the tree, never blocks on writers
+    // except to wait out a rotation of the node it stands on
+    bool contains(const Key& key) const {
+        Epoch_Guard guard(this);
+        while (true) {
+            Outcome result = this->attempt_get(key, this->holder, 1, 0);
+            if (result != RETRY) {
+                return result == YES;
+            }
+        }
+    }
+    
+    // return true if key was not there before
+    bool insert(const Key& key) {
+        return this->update(key, true);
+    }
+    
+    // return true if key was there before
+    bool remove(const Key& key) {
+        return this->update(key, false);
+    }
+    
+    // exact once writers are done
+    size_t num_elements() const {
+        return this->size;
+    }
+    
+    // height including routing nodes, exact once writers are done
+    int height() const {
+        return this->height(this->holder->right);
+    }
+    
+    // visit keys in order, not safe against concurrent writers
+    template <typename Visit>
+    void for_each(Visit visit) const {
+        this->for_each(this->holder->right, visit);
+    }
+    
+    // num of unlinked nodes waiting to be freed, exact once writers are done
+    size_t num_retired() const {
+        size_t count = 0;
+        for (Participant* record = this->participants.load(); record; record = record->next) {
+            count += record->retired.size();
+        }
+        return count;
+    }
+    
+    // free every unlinked node right away and return how many,
+    // only call this when no other thread is inside the tree
+    size_t reclaim() {
+        size_t count = 0;
+        for (Participant* record = this->participants.load(); record; record = record->next) {
+            count += record->retired.size();
+            for (auto& entry : record->retired) {
+                delete entry.second;
+            }
+            record->retired.clear();
+            record->next_collect = RECLAIM_BATCH;
+        }
+        return count;
+    }
+    
+private:
+    struct Node {
+        Node(const Key& key, Node* parent, bool present)
+        : key(key), present(present), parent(parent) {}
+        
+        atomic<Node*>& child(int dir) {
+            return dir < 0 ? this->left : this->right;
+        }
+        
+        const Key key;
+        // false for routing nodes left behind by remove
+        atomic<bool> present;
+        atomic<int> height{1};
+        // bumped after every rotation moving this node down
+        atomic<uint64_t> version{0};
+        atomic<Node*> parent;
+        atomic<Node*> left{nullptr};
+        atomic<Node*> right{nullptr};
+        mutex lock;
+    };
+    
+    enum Outcome { NO, YES, RETRY };
+    
+    // version bits
+    static const uint64_t UNLINKED = 1;
+    static const uint64_t SHRINKING = 2;
+    static const uint64_t VERSION_STEP = 4;
+    // results of node_condition besides a new height
+    static const int NOTHING_REQUIRED = -1;
+    static const int REBALANCE_REQUIRED = -2;
+    static const int UNLINK_REQUIRED = -3;
+    static const int SPIN_COUNT = 100;
+    // epoch announced by threads outside the tree
+    static const uint64_t QUIESCENT = ~uint64_t(0);
+    // retired nodes a thread gathers before trying to free them
+    static const size_t RECLAIM_BATCH = 64;
+    
+    // a thread's epoch record, found again by thread id; a thread
+    // that exits leaves its record to the next one given its id
+    struct Participant {
+        Participant() : owner(this_thread::get_id()) {}
+        
+        // records of different threads stay off each other's cache lines
+        char front_padding[64];
+        atomic<uint64_t> epoch{QUIESCENT};
+        char back_padding[64];
+        const thread::id owner;
+        Participant* next = nullptr;
+        // <epoch unlinked in, node> oldest first, only the owner touches them
+        vector<pair<uint64_t, Node*>> retired;
+        size_t next_collect = RECLAIM_BATCH;
+    };
+    
+    // announces the epoch for the length of an operation
+    class Epoch_Guard {
+    public:
+        explicit Epoch_Guard(const Concurrent_AVLTree* tree) : record(tree->participant()) {
+            this->record->epoch = tree->epoch.load();
+        }
+        
+        ~Epoch_Guard() {
+            this->record->epoch = QUIESCENT;
+        }
+        
+        Participant* record;
+    };
+    
+    Compare comp;
+    // sentinel above the root, which is its right child
+    Node* holder;
+    atomic<size_t> size{0};
+    // tells trees apart in the per thread record cache
+    const uint64_t id;
+    atomic<uint64_t> epoch{0};
+    // pushed at the front, freed at destruction
+    mutable atomic<Participant*> participants{nullptr};
+    
+    static uint64_t next_id() {
+        static atomic<uint64_t> counter(0);
+        return ++ counter;
+    }
+    
+    // record of the calling thread, the last one used is cached
+    Participant* participant() const {
+        static thread_local uint64_t cached_id = 0;
+        static thread_local Participant* cached = nullptr;
+        if (cached_id == this->id) {
+            return cached;
+        }
+        thread::id self = this_thread::get_id();
+        Participant* record = this->participants.load();
+        while (record && record->owner != self) {
+            record = record->next;
+        }
+        if (!record) {
+            record = new Participant();
+            record->next = this->participants.load();
+            while (!this->participants.compare_exchange_weak(record->next, record)) {
+            }
+        }
+        cached_id = this->id;
+        cached = record;
+        return record;
+    }
+    
+    // move the epoch on if every thread inside has seen the current one
+    void try_advance() {
+        uint64_t current = this->epoch.load();
+        for (Participant* record = this->participants.load(); record; record = record->next) {
+            uint64_t announced = record->epoch.load();
+            if (announced != QUIESCENT && announced != current) {
+                return;
+            }
+        }
+        this->epoch.compare_exchange_strong(current, current + 1);
+    }
+    
+    // free the nodes of record retired two epochs ago or earlier,
+    // called by its owner outside any operation
+    void collect(Participant* record) {
+        if (record->retired.size() < record->next_collect) {
+            return;
+        }
+        this->try_advance();
+        uint64_t safe = this->epoch.load();
+        size_t kept = 0;
+        for (auto& entry : record->retired) {
+            if (entry.first + 2 <= safe) {
+                delete entry.second;
+            } else {
+                record->retired[kept ++] = entry;
+            }
+        }
+        record->retired.resize(kept);
+        // nodes that could not go yet wait for another batch
+        record->next_collect = kept + RECLAIM_BATCH;
+    }
+    
+    int compare(const Key& lhs, const Key& rhs) const {
+        if (this->comp(lhs, rhs)) return -1;
+        if (this->comp(rhs, lhs)) return 1;
+        return 0;
+    }
+    
+    int height(Node* node) const {
+        return node ? node->height.load() : 0;
+    }
+    
+    static bool is_changing(uint64_t version) {
+        return (version & (UNLINKED | SHRINKING)) != 0;
+    }
+    
+    // rotations happen under the node's lock,
+    // after a short spin wait for them by taking it
+    static void wait_until_shrunk(Node* node, uint64_t version) {
+        if (!(version & SHRINKING)) {
+            return;
+        }
+        for (int i = 0; i < SPIN_COUNT; ++ i) {
+            if (node->version != version) {
+                return;
+            }
+        }
+        lock_guard<mutex> guard(node->lock);
+    }
+    
+    // search below node, which had the given version when we read
+    // the link to it; its child in dir leads towards key
+    Outcome attempt_get(const Key& key, Node* node, int dir, uint64_t version) const {
+        while (true) {
+            Node* child = node->child(dir);
+            if (!child) {
+                return node->version != version ? RETRY : NO;
+            }
+            int next_dir = this->compare(key, child->key);
+            if (next_dir == 0) {
+                return child->present ? YES : NO;
+            }
+            uint64_t child_version = child->version;
+            if (is_changing(child_version)) {
+                wait_until_shrunk(child, child_version);
+                if (node->version != version) {
+                    return RETRY;
+                }
+            } else if (child != node->child(dir)) {
+                if (node->version != version) {
+                    return RETRY;
+                }
+            } else {
+                // the link to child was valid as long as node is unchanged
+                if (node->version != version) {
+                    return RETRY;
+                }
+                Outcome result = this->attempt_get(key, child, next_dir, child_version);
+                if (result != RETRY) {
+                    return result;
+                }
+            }
+        }
+    }
+    
+    bool update(const Key& key, bool insert) {
+        Outcome result;
+        Participant* record;
+        {
+            Epoch_Guard guard(this);
+            record = guard.record;
+            do {
+                result = this->attempt_update(key, insert, this->holder, 1, 0);
+            } while (result == RETRY);
+        }
+        if (result == YES) {
+            insert ? ++ this->size : -- this->size;
+        }
+        this->collect(record);
+        return result == YES;
+    }
+    
+    // same descent as attempt_get, linking a new node at the bottom
+    Outcome attempt_update(const Key& key, bool insert, Node* node, int dir, uint64_t version) {
+        while (true) {
+            Node* child = node->child(dir);
+            if (node->version != version) {
+                return RETRY;
+            }
+            if (!child) {
+                if (!insert) {
+                    return NO;
+                }
+                {
+                    lock_guard<mutex> guard(node->lock);
+                    if (node->version != version) {
+                        return RETRY;
+                    }
+                    if (node->child(dir)) {
+                        // lost the race for this slot
+                        continue;
+                    }
+                    node->child(dir) = new Node(key, node, true);
+                }
+                this->fix_height_and_rebalance(node);
+                return YES;
+            }
+            
+            int next_dir = this->compare(key, child->key);
+            if (next_dir == 0) {
+                Outcome result = this->attempt_node_update(insert, node, child);
+                if (result != RETRY) {
+                    return result;
+                }
+                continue;
+            }
+            uint64_t child_version = child->version;
+            if (is_changing(child_version)) {
+                wait_until_shrunk(child, child_version);
+            } else if (child == node->child(dir)) {
+                if (node->version != version) {
+                    return RETRY;
+                }
+                Outcome result = this->attempt_update(key, insert, child, next_dir, child_version);
+                if (result != RETRY) {
+                    return result;
+                }
+            }
+        }
+    }
+    
+    // key matches node, flip its presence
+    // or unlink it when it has at most one child
+    Outcome attempt_node_update(bool insert, Node* parent, Node* node) {
+        if (insert == node->present) {
+            return NO;
+        }
+        if (!insert && (!node->left || !node->right)) {
+            Node* damaged;
+            {
+                lock_guard<mutex> parent_guard(parent->lock);
+                if ((parent->version & UNLINKED) || node->parent != parent) {
+                    return RETRY;
+                }
+                lock_guard<mutex> guard(node->lock);
+                if (!node->present) {
+                    return NO;
+                }
+                node->present = false;
+                if (!this->attempt_unlink(parent, node)) {
+                    // gained a second child, stays as a routing node
+                    return YES;
+                }
+                damaged = this->fix_height(parent);
+            }
+            this->fix_height_and_rebalance(damaged);
+            return YES;
+        }
+        
+        lock_guard<mutex> guard(node->lock);
+        if (node->version & UNLINKED) {
+            return RETRY;
+        }
+        if (insert == node->present) {
+            return NO;
+        }
+        if (!insert && (!node->left || !node->right)) {
+            // can be unlinked now, go through the parent
+            return RETRY;
+        }
+        node->present = insert;
+        return YES;
+    }
+    
+    // splice out node with at most one child, parent and node locked
+    bool attempt_unlink(Node* parent, Node* node) {
+        Node* parent_left = parent->left;
+        if (parent_left != node && parent->right != node) {
+            return false;
+        }
+        Node* left = node->left;
+        Node* right = node->right;
+        if (left && right) {
+            return false;
+        }
+        Node* splice = left ? left : right;
+        parent->child(parent_left == node ? -1 : 1) = splice;
+        if (splice) {
+            splice->parent = parent;
+        }
+        node->version = node->version | UNLINKED;
+        
+        // tagged after the unlink, readers arriving later cannot reach it
+        this->participant()->retired.push_back(make_pair(this->epoch.load(), node));
+        return true;
+    }
+    
+    // what node needs, or its new height if only that is stale
+    int node_condition(Node* node) const {
+        Node* left = node->left;
+        Node* right = node->right;
+        if ((!left || !right) && !node->present) {
+            return UNLINK_REQUIRED;
+        }
+        int left_height = this->height(left);
+        int right_height = this->height(right);
+        int new_height = 1 + max(left_height, right_height);
+        int bal = left_height - right_height;
+        if (bal < -1 || bal > 1) {
+            return REBALANCE_REQUIRED;
+        }
+        return new_height != node->height ? new_height : NOTHING_REQUIRED;
+    }
+    
+    // refresh the height of a locked node,
+    // return the next node needing work or nullptr
+    Node* fix_height(Node* node) {
+        int condition = this->node_condition(node);
+        if (condition == REBALANCE_REQUIRED || condition == UNLINK_REQUIRED) {
+            return node;
+        }
+        if (condition == NOTHING_REQUIRED) {
+            return nullptr;
+        }
+        node->height = condition;
+        return node->parent;
+    }
+    
+    // walk up from a damaged node, locking a node (and its parent
+    // when the shape changes) one step at a time
+    void fix_height_and_rebalance(Node* node) {
+        while (node && node->parent) {
+            int condition = this->node_condition(node);
+            if (condition == NOTHING_REQUIRED || (node->version & UNLINKED)) {
+                return;
+            }
+            if (condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED) {
+                lock_guard<mutex> guard(node->lock);
+                node = this->fix_height(node);
+            } else {
+                Node* parent = node->parent;
+                lock_guard<mutex> parent_guard(parent->lock);
+                if (!(parent->version & UNLINKED) && node->parent == parent) {
+                    lock_guard<mutex> guard(node->lock);
+                    node = this->rebalance(parent, node);
+                }
+                // otherwise retry with node's new parent
+            }
+        }
+    }
+    
+    // parent and node locked
+    Node* rebalance(Node* parent, Node* node) {
+        Node* left = node->left;
+        Node* right = node->right;
+        if ((!left || !right) && !node->present) {
+            if (this->attempt_unlink(parent, node)) {
+                return this->fix_height(parent);
+            }
+            return node;
+        }
+        int left_height = this->height(left);
+        int right_height = this->height(right);
+        int new_height = 1 + max(left_height, right_height);
+        int bal = left_height - right_height;
+        if (bal > 1) {
+            return this->rebalance_to(parent, node, left, right_height, -1);
+        }
+        if (bal < -1) {
+            return this->rebalance_to(parent, node, right, left_height, 1);
+        }
+        if (new_height != node->height) {
+            node->height = new_height;
+            return this->fix_height(parent);
+        }
+        return nullptr;
+    }
+    
+    // node is heavy on side dir where its child is heavy,
+    // rotate the other way, twice if heavy's inner side is taller
+    Node* rebalance_to(Node* parent, Node* node, Node* heavy, int other_height, int dir) {
+        unique_lock<mutex> guard(heavy->lock);
+        int heavy_height = heavy->height;
+        if (heavy_height - other_height <= 1) {
+            // changed since we looked, retry
+            return node;
+        }
+        Node* inner = heavy->child(-dir);
+        int outer_height = this->height(heavy->child(dir));
+        int inner_height = this->height(inner);
+        if (outer_height >= inner_height) {
+            return this->rotate(parent, node, heavy, other_height, outer_height, inner, inner_height, dir);
+        }
+        {
+            lock_guard<mutex> inner_guard(inner->lock);
+            inner_height = inner->height;
+            if (outer_height >= inner_height) {
+                return this->rotate(parent, node, heavy, other_height, outer_height, inner, inner_height, dir);
+            }
+            int inner_outer_height = this->height(inner->child(dir));
+            int bal = outer_height - inner_outer_height;
+            if (bal >= -1 && bal <= 1 &&
+                !((outer_height == 0 || inner_outer_height == 0) && !heavy->present)) {
+                return this->rotate_double(parent, node, heavy, other_height, outer_height,
+                                           inner, inner_outer_height, dir);
+            }
+        }
+        // heavy has to be fixed first, heavy still locked
+        return this->rebalance_to(node, heavy, inner, outer_height, -dir);
+    }
+    
+    static void begin_shrink(Node* node, uint64_t version) {
+        node->version = version | SHRINKING;
+    }
+    
+    static void end_shrink(Node* node, uint64_t version) {
+        node->version = (version + VERSION_STEP) & ~SHRINKING;
+    }
+    
+    // heavy (node's child on side dir) takes node's place,
+    // all four nodes locked; return the next node needing work
+    Node* rotate(Node* parent, Node* node, Node* heavy, int other_height,
+                 int outer_height, Node* inner, int inner_height, int dir) {
+        uint64_t version = node->version;
+        Node* parent_left = parent->left;
+        begin_shrink(node, version);
+        
+        node->child(dir) = inner;
+        if (inner) {
+            inner->parent = node;
+        }
+        heavy->child(-dir) = node;
+        node->parent = heavy;
+        parent->child(parent_left == node ? -1 : 1) = heavy;
+        heavy->parent = parent;
+        
+        int node_height = 1 + max(inner_height, other_height);
+        node->height = node_height;
+        heavy->height = 1 + max(outer_height, node_height);
+        end_shrink(node, version);
+        
+        // heights of unlocked nodes may be stale, see what is left
+        int bal = inner_height - other_height;
+        if (bal < -1 || bal > 1) {
+            return node;
+        }
+        if ((!inner || other_height == 0) && !node->present) {
+            return node;
+        }
+        bal = outer_height - node_height;
+        if (bal < -1 || bal > 1) {
+            return heavy;
+        }
+        if (outer_height == 0 && !heavy->present) {
+            return heavy;
+        }
+        return this->fix_height(parent);
+    }
+    
+    // inner (heavy's child on side -dir) takes node's place
+    // with heavy and node as its children
+    Node* rotate_double(Node* parent, Node* node, Node* heavy, int other_height,
+                        int outer_height, Node* inner, int inner_outer_height, int dir) {
+        uint64_t version = node->version;
+        uint64_t heavy_version = heavy->version;
+        Node* parent_left = parent->left;
+        Node* inner_outer = inner->child(dir);
+        Node* inner_inner = inner->child(-dir);
+        int inner_inner_height = this->height(inner_inner);
+        begin_shrink(node, version);
+        begin_shrink(heavy, heavy_version);
+        
+        node->child(dir) = inner_inner;
+        if (inner_inner) {
+            inner_inner->parent = node;
+        }
+        heavy->child(-dir) = inner_outer;
+        if (inner_outer) {
+            inner_outer->parent = heavy;
+        }
+        inner->child(dir) = heavy;
+        heavy->parent = inner;
+        inner->child(-dir) = node;
+        node->parent = inner;
+        parent->child(parent_left == node ? -1 : 1) = inner;
+        inner->parent = parent;
+        
+        int node_height = 1 + max(inner_inner_height, other_height);
+        node->height = node_height;
+        int heavy_height = 1 + max(outer_height, inner_outer_height);
+        heavy->height = heavy_height;
+        inner->height = 1 + max(heavy_height, node_height);
+        end_shrink(node, version);
+        end_shrink(heavy, heavy_version);
+        
+        int bal = inner_inner_height - other_height;
+        if (bal < -1 || bal > 1) {
+            return node;
+        }
+        if ((!inner_inner || other_height == 0) && !node->present) {
+            return node;
+        }
+        bal = heavy_height - node_height;
+        if (bal < -1 || bal > 1) {
+            return inner;
+        }
+        return this->fix_height(parent);
+    }
+    
+    template <typename Visit>
+    void for_each(Node* node, Visit& visit) const {
+        if (!node) {
+            return;
+        }
+        this->for_each(node->left.load(), visit);
+        if (node->present) {
+            visit(node->key);
+        }
+        this->for_each(node->right.load(), visit);
+    }
+    
+    void destroy(Node* node) {
+        if (!node) {
+            return;
+        }
+        this->destroy(node->left);
+        this->destroy(node->right);
+        delete node;
+    }
+};
+
+// Persistent AVL tree, every version is immutable. insert and remove
+// copy only the nodes on the path they change and return a new version
+// sharing the rest, so a snapshot is just a copy of the root pointer.
+// Nodes are reference counted and go away with the last version using
+// them; versions may be read from any thread while others are built
+template <typename Key, typename Value = void, typename Compare = less<Key>>
+class Persistent_AVLTree {
+public:
+    typedef typename AVL_Traits<Key, Value>::value_type value_type;
+    
+    explicit Persistent_AVLTree(const Compare& comp = Compare()) : comp(comp) {}
+    
+    // new version with val added, or this version if its key exists
+    Persistent_AVLTree insert(const value_type& val) const {
+        bool changed = false;
+        Node_Ptr root = this->insert_impl(this->root, val, changed);
+        return Persistent_AVLTree(root, this->size + changed, this->comp);
+    }
+    
+    // new version without key
+    Persistent_AVLTree remove(const Key& key) const {
+        bool changed = false;
+        Node_Ptr root = this->remove_impl(this->root, key, changed);
+        return Persistent_AVLTree(root, this->size - changed, this->comp);
+    }
+    
+    // element with key, nullptr if not found,
+    // valid as long as a version holding it lives
+    const value_type* find(const Key& key) const {
+        const Node* current = this->root.get();
+        while (current) {
+            if (this->comp(key, current->key())) {
+                current = current->left.get();
+            } else if (this->comp(current->key(), key)) {
+                current = current->right.get();
+            } else {
+                return &current->data;
+            }
+        }
+        return nullptr;
+    }
+    
+    bool contains(const Key& key) const {
+        return this->find(key) != nullptr;
+    }
+    
+    // visit every element in order
+    template <typename Visit>
+    void for_each(Visit visit) const {
+        this->for_each(this->root.get(), visit);
+    }
+    
+    // visit every element with key in [lo, hi) in order
+    template <typename Visit>
+    void range(const Key& lo, const Key& hi, Visit visit) const {
+        this->range(this->root.get(), lo, hi, visit);
+    }
+    
+    size_t num_elements() const {
+        return this->size;
+    }
+    
+    bool empty() const {
+        return this->size == 0;
+    }
+    
+    int height() const {
+        return this->height(this->root);
+    }
+    
+private:
+    struct Node;
+    typedef shared_ptr<const Node> Node_Ptr;
+    
+    struct Node {
+        Node(const value_type& data, const Node_Ptr& left, const Node_Ptr& right, int height)
+        : data(data), left(left), right(right), height(height) {}
+        
+        const Key& key() const {
+            return AVL_Traits<Key, Value>::key(this->data);
+        }
+        
+        value_type data;
+        Node_Ptr left;
+        Node_Ptr right;
+        int height;
+    };
+    
+    Node_Ptr root;
+    size_t size = 0;
+    Compare comp;
+    
+    Persistent_AVLTree(const Node_Ptr& root, size_t size, const Compare& comp)
+    : root(root), size(size), comp(comp) {}
+    
+    int height(const Node_Ptr& node) const {
+        return node ? node->height : 0;
+    }
+    
+    Node_Ptr make_node(const value_type& data, const Node_Ptr& left, const Node_Ptr& right) const {
+        int height = 1 + max(this->height(left), this->height(right));
+        return make_shared<const Node>(data, left, right, height);
+    }
+    
+    // new node over left and right, which differ in height by at most 2,
+    // rotations build new nodes instead of relinking old ones
+    Node_Ptr balance(const value_type& data, const Node_Ptr& left, const Node_Ptr& right) const {
+        int bal = this->height(left) - this->height(right);
+        if (bal > 1) {
+            if (this->height(left->left) >= this->height(left->right)) {
+                return this->make_node(left->data, left->left,
+                                       this->make_node(data, left->right, right));
+            }
+            const Node_Ptr& inner = left->right;
+            return this->make_node(inner->data,
+                                   this->make_node(left->data, left->left, inner->left),
+                                   this->make_node(data, inner->right, right));
+        }
+        if (bal < -1) {
+            if (this->height(right->right) >= this->height(right->left)) {
+                return this->make_node(right->data,
+                                       this->make_node(data, left, right->left),
+                                       right->right);
+            }
+            const Node_Ptr& inner = right->left;
+            return this->make_node(inner->data,
+                                   this->make_node(data, left, inner->left),
+                                   this->make_node(right->data, inner->right, right->right));
+        }
+        return this->make_node(data, left, right);
+    }
+    
+    // unchanged subtrees come back as they are
+    Node_Ptr insert_impl(const Node_Ptr& node, const value_type& val, bool& changed) const {
+        if (!node) {
+            changed = true;
+            return this->make_node(val, nullptr, nullptr);
+        }
+        const Key& key = AVL_Traits<Key, Value>::key(val);
+        if (this->comp(key, node->key())) {
+            Node_Ptr left = this->insert_impl(node->left, val, changed);
+            return changed ? this->balance(node->data, left, node->right) : node;
+        }
+        if (this->comp(node->key(), key)) {
+            Node_Ptr right = this->insert_impl(node->right, val, changed);
+            return changed ? this->balance(node->data, node->left, right) : node;
+        }
+        return node;
+    }
+    
+    Node_Ptr remove_impl(const Node_Ptr& node, const Key& key, bool& changed) const {
+        if (!node) {
+            return nullptr;
+        }
+        if (this->comp(key, node->key())) {
+            Node_Ptr left = this->remove_impl(node->left, key, changed);
+            return changed ? this->balance(node->data, left, node->right) : node;
+        }
+        if (this->comp(node->key(), key)) {
+            Node_Ptr right = this->remove_impl(node->right, key, changed);
+            return changed ? this->balance(node->data, node->left, right) : node;
+        }
+        changed = true;
+        if (!node->left) {
+            return node->right;
+        }
+        if (!node->right) {
+            return node->left;
+        }
+        // the successor takes node's place
+        const value_type* successor = nullptr;
+        Node_Ptr right = this->remove_min(node->right, successor);
+        return this->balance(*successor, node->left, right);
+    }
+    
+    // copy of node without its minimum, which is handed back in min
+    Node_Ptr remove_min(const Node_Ptr& node, const value_type*& min) const {
+        if (!node->left) {
+            min = &node->data;
+            return node->right;
+        }
+        Node_Ptr left = this->remove_min(node->left, min);
+        return this->balance(node->data, left, node->right);
+    }
+    
+    template <typename Visit>
+    void for_each(const Node* node, Visit& visit) const {
+        if (!node) {
+            return;
+        }
+        this->for_each(node->left.get(), visit);
+        visit(node->data);
+        this->for_each(node->right.get(), visit);
+    }
+    
+    template <typename Visit>
+    void range(const Node* node, const Key& lo, const Key& hi, Visit& visit) const {
+        if (!node) {
+            return;
+        }
+        bool above_lo = !this->comp(node->key(), lo);
+        bool below_hi = this->comp(node->key(), hi);
+        if (above_lo) {
+            this->range(node->left.get(), lo, hi, visit);
+        }
+        if (above_lo && below_hi) {
+            visit(node->data);
+        }
+        if (below_hi) {
+            this->range(node->right.get(), lo, hi, visit);
+        }
     }
 };
 
 void test_insertion() {
-    AVLTree tree;
+    AVLTree<int> tree;
     ostringstream oss;
 
     // Set 1
@@ -346,7 +2111,7 @@ void test_insertion() {
 }
 
 void test_deletion() {
-    AVLTree tree;
+    AVLTree<int> tree;
     ostringstream oss;
     
     int set2[] = { 9, 5, 10, 0, 6, 11, -1, 1, 2 };
@@ -363,10 +2128,495 @@ void test_deletion() {
     cout << "Test deletion passed!" << endl;
 }
 
+void test_arena() {
+    // removed nodes get reused
+    AVLTree<int> tree;
+    for (int i = 0; i < 1000; ++ i) {
+        tree.insert(i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        tree.remove(i);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        tree.insert(i);
+    }
+    assert(tree.num_elements() == 1000);
+    
+    // clear releases everything at once
+    tree.clear();
+    assert(tree.root == nullptr && tree.num_elements() == 0);
+    for (int i = 0; i < 1000; ++ i) {
+        tree.insert(-i);
+    }
+    assert(tree.num_elements() == 1000);
+    
+    // trees sharing a caller supplied arena
+    AVLTree<int>::Arena arena(64);
+    {
+        AVLTree<int> tree1(arena);
+        AVLTree<int> tree2(arena);
+        for (int i = 0; i < 100; ++ i) {
+            tree1.insert(i);
+            tree2.insert(i * 2);
+        }
+        assert(arena.capacity() == 256);
+        tree1.clear();
+        for (int i = 0; i < 100; ++ i) {
+            tree2.insert(i * 2 + 1);
+        }
+        // tree1's nodes got recycled for tree2
+        assert(arena.capacity() == 256);
+        
+        ostringstream oss;
+        tree2.in_order(tree2.root, oss);
+        assert(!oss.str().empty());
+    }
+    
+    cout << "Test arena passed!" << endl;
+}
+
+void test_search() {
+    AVLTree<int> tree;
+    for (int i = 0; i < 100; i += 2) {
+        tree.insert(i);
+    }
+    
+    assert(tree.find(42) != tree.end() && *tree.find(42) == 42);
+    assert(tree.find(43) == tree.end());
+    assert(tree.contains(0) && tree.contains(98));
+    assert(!tree.contains(-1) && !tree.contains(99));
+    
+    assert(*tree.lower_bound(42) == 42);
+    assert(*tree.lower_bound(43) == 44);
+    assert(*tree.lower_bound(-5) == 0);
+    assert(tree.lower_bound(99) == tree.end());
+    assert(*tree.upper_bound(42) == 44);
+    assert(*tree.upper_bound(-1) == 0);
+    assert(tree.upper_bound(98) == tree.end());
+    
+    // half open range, only relevant nodes get visited
+    ostringstream oss;
+    tree.range(10, 20, [&oss](int val) { oss << val << ' '; });
+    assert(oss.str() == "10 12 14 16 18 ");
+    
+    int count = 0;
+    tree.range(11, 11, [&count](int) { ++ count; });
+    tree.range(200, 300, [&count](int) { ++ count; });
+    assert(count == 0);
+    
+    cout << "Test search passed!" << endl;
+}
+
+// check heights, balance, parent links and ordering of a subtree
+// return its height
+template <typename Tree>
+int check_avl(const Tree& tree, typename Tree::Node* node, typename Tree::Node* parent) {
+    if (!node) {
+        return 0;
+    }
+    assert(node->parent == parent);
+    if (node->left) {
+        assert(node->left->key() < node->key());
+    }
+    if (node->right) {
+        assert(node->key() < node->right->key());
+    }
+    int l = check_avl(tree, node->left, node);
+    int r = check_avl(tree, node->right, node);
+    assert(abs(l - r) <= 1);
+    assert(node->height == max(l, r) + 1);
+    assert(node->subtree_size == tree.subtree_size(node->left) + tree.subtree_size(node->right) + 1);
+    return node->height;
+}
+
+void test_generic() {
+    // map with move-only values
+    AVLTree<string, unique_ptr<int>> map;
+    assert(map.emplace("b", unique_ptr<int>(new int(2))).second);
+    assert(map.emplace("a", unique_ptr<int>(new int(1))).second);
+    assert(map.emplace("c", unique_ptr<int>(new int(3))).second);
+    auto dup = map.emplace("b", unique_ptr<int>(new int(20)));
+    assert(!dup.second && *dup.first->second == 2);
+    assert(map.num_elements() == 3);
+    
+    string keys;
+    int sum = 0;
+    for (auto& kv : map) {
+        keys += kv.first;
+        sum += *kv.second;
+    }
+    assert(keys == "abc" && sum == 6);
+    
+    // walk backwards from end
+    auto it = map.end();
+    -- it;
+    assert(it->first == "c");
+    -- it;
+    assert(it->first == "b");
+    
+    // erase returns the next element
+    it = map.erase(map.find("a"));
+    assert(it->first == "b");
+    assert(!map.remove("a") && map.remove("c"));
+    assert(map.num_elements() == 1);
+    
+    // custom comparator, descending set
+    AVLTree<int, void, greater<int>> desc;
+    for (int i = 0; i < 10; ++ i) {
+        desc.insert(i);
+    }
+    vector<int> order(desc.begin(), desc.end());
+    assert(order.front() == 9 && order.back() == 0);
+    
+    // random inserts and removes against std::set
+    AVLTree<int> tree;
+    set<int> expected;
+    unsigned seed = 1;
+    for (int i = 0; i < 20000; ++ i) {
+        seed = seed * 1103515245 + 12345;
+        int val = (seed >> 8) % 2000;
+        if (seed & 1) {
+            assert(tree.insert(val).second == expected.insert(val).second);
+        } else {
+            assert(tree.remove(val) == (expected.erase(val) == 1));
+        }
+    }
+    check_avl(tree, tree.root, nullptr);
+    assert(tree.num_elements() == expected.size());
+    assert(equal(tree.begin(), tree.end(), expected.begin()));
+    
+    // moving hands over the nodes
+    AVLTree<int> moved(std::move(tree));
+    assert(tree.empty() && moved.num_elements() == expected.size());
+    tree.insert(1);
+    assert(tree.num_elements() == 1);
+    
+    cout << "Test generic passed!" << endl;
+}
+
+void test_order_statistics() {
+    AVLTree<int> tree;
+    set<int> expected;
+    unsigned seed = 9;
+    for (int i = 0; i < 5000; ++ i) {
+        seed = seed * 1103515245 + 12345;
+        int val = (seed >> 8) % 1000;
+        if (i % 3 == 2) {
+            tree.remove(val);
+            expected.erase(val);
+        } else {
+            tree.insert(val);
+            expected.insert(val);
+        }
+    }
+    check_avl(tree, tree.root, nullptr);
+    assert(tree.subtree_size(tree.root) == expected.size());
+    
+    // select walks the sorted order
+    size_t k = 0;
+    for (int val : expected) {
+        assert(*tree.select(k) == val);
+        assert(tree.rank(val) == k);
+        ++ k;
+    }
+    assert(tree.select(k) == tree.end());
+    
+    // rank of absent keys and range counts
+    assert(tree.rank(-1) == 0);
+    assert(tree.rank(1000) == expected.size());
+    for (int lo = -10; lo < 1010; lo += 37) {
+        int hi = lo + 100;
+        size_t count = distance(expected.lower_bound(lo), expected.lower_bound(hi));
+        assert(tree.count_range(lo, hi) == count);
+    }
+    assert(tree.count_range(50, 10) == 0);
+    
+    cout << "Test order statistics passed!" << endl;
+}
+
+void test_bulk() {
+    // bulk build matches one by one inserts
+    vector<int> sorted;
+    for (int i = 0; i < 10000; ++ i) {
+        sorted.push_back(i * 3);
+    }
+    AVLTree<int> tree;
+    tree.build_sorted(sorted.begin(), sorted.end());
+    check_avl(tree, tree.root, nullptr);
+    assert(tree.num_elements() == sorted.size());
+    assert(equal(tree.begin(), tree.end(), sorted.begin()));
+    
+    // split at present and absent keys, then join back
+    int split_keys[] = { -5, 0, 1, 4500, 4501, 29997, 40000 };
+    for (int key : split_keys) {
+        AVLTree<int> upper = tree.split(key);
+        check_avl(tree, tree.root, nullptr);
+        check_avl(upper, upper.root, nullptr);
+        assert(tree.num_elements() == tree.rank(key));
+        assert(tree.num_elements() + upper.num_elements() == sorted.size());
+        assert(tree.empty() || *(-- tree.end()) < key);
+        assert(upper.empty() || *upper.begin() >= key);
+        
+        tree.join(std::move(upper));
+        check_avl(tree, tree.root, nullptr);
+        assert(upper.empty());
+        assert(equal(tree.begin(), tree.end(), sorted.begin()));
+    }
+    
+    // join trees of very different heights
+    AVLTree<int> small;
+    small.insert(100000);
+    tree.join(std::move(small));
+    check_avl(tree, tree.root, nullptr);
+    assert(tree.num_elements() == sorted.size() + 1);
+    
+    // union of overlapping trees from different pools,
+    // large enough to run halves in parallel
+    AVLTree<int> a;
+    AVLTree<int> b;
+    vector<int> odds;
+    vector<int> mixed;
+    set<int> expected;
+    for (int i = 0; i < 200000; ++ i) {
+        odds.push_back(i * 2 + 1);
+        mixed.push_back(i * 3);
+        expected.insert(i * 2 + 1);
+        expected.insert(i * 3);
+    }
+    a.build_sorted(odds.begin(), odds.end());
+    b.build_sorted(mixed.begin(), mixed.end());
+    a.merge(std::move(b));
+    check_avl(a, a.root, nullptr);
+    assert(b.empty());
+    assert(a.num_elements() == expected.size());
+    assert(equal(a.begin(), a.end(), expected.begin()));
+    
+    // union of trees sharing a pool after a split
+    AVLTree<int> c = a.split(100000);
+    a.merge(std::move(c));
+    check_avl(a, a.root, nullptr);
+    assert(equal(a.begin(), a.end(), expected.begin()));
+    
+    // halves of a split share a pool, write them from separate threads
+    a.set_thread_safe(true);
+    AVLTree<int> d = a.split(300000);
+    size_t lower_size = a.num_elements();
+    size_t upper_size = d.num_elements();
+    thread lower_writer([&]() {
+        for (int i = 0; i < 20000; ++ i) {
+            a.insert(-1 - i);
+            a.remove(-1 - i / 2);
+        }
+    });
+    for (int i = 0; i < 20000; ++ i) {
+        d.insert(1000000 + i);
+        d.remove(1000000 + i / 2);
+    }
+    lower_writer.join();
+    check_avl(a, a.root, nullptr);
+    check_avl(d, d.root, nullptr);
+    assert(a.num_elements() == lower_size + 10000);
+    assert(d.num_elements() == upper_size + 10000);
+    
+    cout << "Test bulk passed!" << endl;
+}
+
+void test_freeze() {
+    AVLTree<int> tree;
+    unsigned seed = 39;
+    for (int i = 0; i < 5000; ++ i) {
+        seed = seed * 1103515245 + 12345;
+        tree.insert((seed >> 8) % 20000);
+    }
+    Frozen_AVLTree<int> frozen = tree.freeze();
+    assert(frozen.num_elements() == tree.num_elements());
+    for (int key = -5; key < 20005; ++ key) {
+        auto it = tree.lower_bound(key);
+        const int* bound = frozen.lower_bound(key);
+        assert(it == tree.end() ? bound == nullptr : bound && *bound == *it);
+        assert(frozen.contains(key) == tree.contains(key));
+    }
+    
+    // the snapshot does not see later writes
+    size_t frozen_size = frozen.num_elements();
+    tree.insert(-100);
+    tree.remove(*tree.select(10));
+    assert(frozen.num_elements() == frozen_size);
+    assert(!frozen.contains(-100));
+    
+    // maps and an empty tree
+    AVLTree<string, int> map;
+    const char* words[] = { "pear", "apple", "fig", "kiwi", "date", "plum" };
+    for (int i = 0; i < 6; ++ i) {
+        map.emplace(words[i], i);
+    }
+    Frozen_AVLTree<string, int> frozen_map = map.freeze();
+    for (int i = 0; i < 6; ++ i) {
+        assert(frozen_map.find(words[i])->second == i);
+    }
+    assert(frozen_map.find("grape") == nullptr);
+    assert(frozen_map.lower_bound("grape")->first == "kiwi");
+    assert(frozen_map.lower_bound("zebra") == nullptr);
+    
+    AVLTree<int> empty;
+    assert(empty.freeze().empty());
+    assert(empty.freeze().lower_bound(0) == nullptr);
+    
+    cout << "Test freeze passed!" << endl;
+}
+
+void test_concurrent() {
+    Concurrent_AVLTree<int> tree;
+    assert(!tree.contains(1) && !tree.remove(1));
+    assert(tree.insert(1) && !tree.insert(1));
+    assert(tree.contains(1) && tree.remove(1) && !tree.contains(1));
+    
+    // multiples of 7 stay put while writers churn the rest
+    const int NUM_KEYS = 21000;
+    for (int key = 0; key < NUM_KEYS; key += 7) {
+        tree.insert(key);
+    }
+    const int NUM_WRITERS = 4;
+    const int NUM_READERS = 4;
+    vector<set<int>> owned(NUM_WRITERS);
+    vector<thread> threads;
+    for (int t = 0; t < NUM_WRITERS; ++ t) {
+        threads.emplace_back([&tree, &owned, t, NUM_KEYS, NUM_WRITERS]() {
+            // each writer owns the keys equal to t mod NUM_WRITERS
+            unsigned seed = t + 1;
+            for (int i = 0; i < 40000; ++ i) {
+                seed = seed * 1103515245 + 12345;
+                int key = (seed >> 8) % (NUM_KEYS / NUM_WRITERS) * NUM_WRITERS + t;
+                if (key % 7 == 0) {
+                    continue;
+                }
+                if (seed & 1) {
+                    assert(tree.insert(key) == owned[t].insert(key).second);
+                } else {
+                    assert(tree.remove(key) == (owned[t].erase(key) == 1));
+                }
+            }
+        });
+    }
+    for (int t = 0; t < NUM_READERS; ++ t) {
+        threads.emplace_back([&tree, NUM_KEYS]() {
+            for (int round = 0; round < 20; ++ round) {
+                for (int key = 0; key < NUM_KEYS; key += 7) {
+                    assert(tree.contains(key));
+                    assert(!tree.contains(-key - 1));
+                }
+            }
+        });
+    }
+    for (thread& t : threads) {
+        t.join();
+    }
+    
+    set<int> expected;
+    for (int key = 0; key < NUM_KEYS; key += 7) {
+        expected.insert(key);
+    }
+    for (const set<int>& keys : owned) {
+        expected.insert(keys.begin(), keys.end());
+    }
+    vector<int> keys;
+    tree.for_each([&keys](int key) { keys.push_back(key); });
+    assert(keys.size() == expected.size());
+    assert(equal(keys.begin(), keys.end(), expected.begin()));
+    assert(tree.num_elements() == expected.size());
+    // quiescent tree is balanced again, routing nodes included
+    assert(tree.height() <= 20);
+    
+    // a quiescent reclaim frees whatever is left
+    size_t retired = tree.num_retired();
+    assert(tree.reclaim() == retired);
+    assert(tree.num_retired() == 0);
+    
+    // steady churn frees unlinked nodes as it goes
+    for (int round = 0; round < 20; ++ round) {
+        for (int key = 1; key < NUM_KEYS; key += 7) {
+            tree.insert(key);
+        }
+        for (int key = 1; key < NUM_KEYS; key += 7) {
+            tree.remove(key);
+        }
+        assert(tree.num_retired() < 2 * 64 + 2);
+    }
+    keys.clear();
+    tree.for_each([&keys](int key) { keys.push_back(key); });
+    assert(tree.num_elements() == keys.size());
+    assert(tree.contains(0) && !tree.contains(1));
+    
+    cout << "Test concurrent passed!" << endl;
+}
+
+void test_persistent() {
+    // snapshot every 100 inserts
+    Persistent_AVLTree<int> tree;
+    vector<Persistent_AVLTree<int>> versions;
+    for (int i = 0; i < 1000; ++ i) {
+        if (i % 100 == 0) {
+            versions.push_back(tree);
+        }
+        tree = tree.insert((i * 37) % 1000);
+    }
+    assert(tree.num_elements() == 1000);
+    assert(tree.height() <= 14);
+    assert(tree.insert(5).num_elements() == 1000);
+    
+    // remove the evens from the latest version only
+    Persistent_AVLTree<int> odds = tree;
+    for (int i = 0; i < 1000; i += 2) {
+        odds = odds.remove(i);
+    }
+    assert(odds.num_elements() == 500);
+    assert(odds.remove(2).num_elements() == 500);
+    assert(!odds.contains(0) && odds.contains(1) && tree.contains(0));
+    
+    for (size_t v = 0; v < versions.size(); ++ v) {
+        assert(versions[v].num_elements() == v * 100);
+        for (size_t i = 0; i < v * 100; ++ i) {
+            assert(versions[v].contains((i * 37) % 1000));
+        }
+        vector<int> keys;
+        versions[v].for_each([&keys](int key) { keys.push_back(key); });
+        assert(keys.size() == v * 100 && is_sorted(keys.begin(), keys.end()));
+    }
+    int count = 0;
+    odds.range(100, 200, [&count](int key) { assert(key >= 100 && key < 200 && key % 2); ++ count; });
+    assert(count == 50);
+    
+    // readers keep a version while a writer moves on
+    Persistent_AVLTree<string, int> map;
+    map = map.insert(make_pair(string("a"), 1)).insert(make_pair(string("b"), 2));
+    Persistent_AVLTree<string, int> snapshot = map;
+    thread reader([snapshot]() {
+        for (int i = 0; i < 1000; ++ i) {
+            assert(snapshot.find("a")->second == 1);
+            assert(snapshot.num_elements() == 2);
+        }
+    });
+    for (int i = 0; i < 1000; ++ i) {
+        map = map.insert(make_pair(to_string(i), i)).remove("a");
+    }
+    reader.join();
+    assert(!map.contains("a") && snapshot.contains("a"));
+    
+    cout << "Test persistent passed!" << endl;
+}
+
 int main() {
     
     test_insertion();
     test_deletion();
+    test_arena();
+    test_search();
+    test_generic();
+    test_order_statistics();
+    test_bulk();
+    test_freeze();
+    test_concurrent();
+    test_persistent();
     
     return 0;
 }